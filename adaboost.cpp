@@ -4,6 +4,19 @@
 #include <stdlib.h>
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+#include <type_traits>
+
+#include "parallel.h"
+#include "csv.h"
+#include "dataset.h"
+#include "benchmark.h"
+#include "datagen.h"
+#include "sweep.h"
 
 
 /*************** ADA_BOOST *******************/
@@ -20,6 +33,80 @@ namespace DM_AG{
   typedef boost::numeric::ublas::matrix<int> MatrixResults;
   typedef std::vector<int> Labels;
 
+  // A row of a contiguous row-major feature matrix
+  //    lets weak classifiers look at several features of one sample
+  template <typename V>
+  struct FeatureRow {
+    const V * values;
+    size_t num_features;
+
+    const V & operator[](size_t feature) const { return values[feature]; }
+  };
+
+  //
+  // A boosted ensemble
+  //
+  //  The weak classifiers picked by the rounds, each once, with the
+  //  sum of the alphas of the rounds that picked it: sized by the
+  //  number of distinct learners, not by samples or pool size.
+  //  Confidence-rated rounds (Real / Gentle AdaBoost, LogitBoost)
+  //  add a different value per answer, a_t h + b_t; the b_t are
+  //  summed into bias. F(x) = bias + sum alphas[t] h_t(x).
+  //
+  struct EnsembleModel {
+
+    std::vector<uint32_t> learners;      // index in the classifier pool
+    ClassificationResults alphas;        // accumulated a_t of each
+    float bias;                          // accumulated b_t
+
+    EnsembleModel() : bias(0) {};
+
+    size_t size() const { return learners.size(); };
+
+    // adds a_t to a learner, appending it on its first pick
+    void add(unsigned int learner, float alpha){
+      for (size_t t=0; t < learners.size(); t++)
+	if (learners[t] == learner){
+	  alphas[t] += alpha;
+	  return;
+	}
+      learners.push_back(learner);
+      alphas.push_back(alpha);
+    };
+  };
+
+  //
+  // A read-only ensemble stored elsewhere
+  //
+  //  An EnsembleModel or a model file mapped in memory (see
+  //  MappedEnsemble); whoever owns the arrays must outlive the view.
+  //
+  struct EnsembleView {
+
+    const uint32_t * learners;
+    const float * alphas;
+    float bias;
+    size_t num_learners;
+
+    size_t size() const { return num_learners; };
+
+    static EnsembleView of(const EnsembleModel & model){
+      EnsembleView v = { model.learners.empty() ? NULL : &model.learners[0],
+			 model.alphas.empty() ? NULL : &model.alphas[0],
+			 model.bias, model.size() };
+      return v;
+    };
+
+    // an owned copy
+    EnsembleModel to_model() const {
+      EnsembleModel model;
+      model.learners.assign(learners, learners + num_learners);
+      model.alphas.assign(alphas, alphas + num_learners);
+      model.bias = bias;
+      return model;
+    };
+  };
+
   // A classifier
   //    abstract class
 
@@ -30,9 +117,158 @@ namespace DM_AG{
     typedef typename boost::ptr_vector<Classifier<T> > CollectionClassifiers;
     typedef typename std::vector<T> Data;
 
+    // pools delete their learners through this base
+    virtual ~Classifier() {}
+
     virtual int analyze(const T& feature) const = 0;
   };
 
+  // A compile-time pool of weak classifiers (see STATIC_CLASSIFIER)
+  template <typename T, typename... Learners>
+  class ClassifierPool;
+
+  // results(c, j) = h_c(samples[j]) for n contiguous samples,
+  // virtual pool (the static pool one is in STATIC_CLASSIFIER)
+  template <typename T>
+  void run_weak_classifiers(const boost::ptr_vector<Classifier<T> > & pool,
+			    const T * samples, size_t n,
+			    MatrixResults & results){
+
+    for (size_t c=0; c < pool.size(); c++){
+      int * row = &results.data()[c * results.size2()];
+      for (size_t j=0; j < n; j++)
+	row[j] = pool[c].analyze(samples[j]);
+    }
+  }
+
+  // answers[j] = h_c(samples[j]) for one weak classifier, virtual pool
+  template <typename T>
+  void run_weak_classifier(const boost::ptr_vector<Classifier<T> > & pool,
+			   size_t c, const T * samples, size_t n,
+			   int * answers){
+
+    const Classifier<T> & h = pool[c];
+    for (size_t j=0; j < n; j++)
+      answers[j] = h.analyze(samples[j]);
+  }
+
+  //
+  // Weak classifier answers packed one bit per sample
+  //
+  //  Bit j of row c is set when h_c(x_j) = +1; the rounds only look
+  //  at the sign of the +1 / -1 answers, so nothing is lost and the
+  //  matrix is 32 times smaller than MatrixResults.
+  //
+  struct PackedResults {
+
+    size_t num_classifiers, num_samples;
+    size_t words;                        // 64-bit words per row
+    std::vector<uint64_t> bits;
+
+    PackedResults() : num_classifiers(0), num_samples(0), words(0) {};
+
+    void resize(size_t classifiers, size_t samples){
+      num_classifiers = classifiers;
+      num_samples = samples;
+      words = (samples + 63) / 64;
+      bits.assign(classifiers * words, 0);
+    };
+
+    // packs columns [first, first + n) from a dense results block
+    void pack(const MatrixResults & results, size_t first, size_t n){
+      for (size_t c=0; c < num_classifiers; c++){
+	const int * h = &results.data()[c * results.size2()];
+	uint64_t * row = &bits[c * words];
+	for (size_t j=0; j < n; j++)
+	  if (h[j] > 0)
+	    row[(first + j) >> 6] |= uint64_t(1) << ((first + j) & 63);
+      }
+    };
+  };
+
+  // A row of dense or packed results, as read by the rounds
+  struct DenseRow {
+    const int * h;
+    bool positive(size_t j) const { return h[j] > 0; };
+  };
+
+  struct PackedRow {
+    const uint64_t * bits;
+    bool positive(size_t j) const { return (bits[j >> 6] >> (j & 63)) & 1; };
+  };
+
+  inline size_t num_classifiers(const MatrixResults & results){
+    return results.size1();
+  }
+  inline size_t num_classifiers(const PackedResults & results){
+    return results.num_classifiers;
+  }
+
+  inline DenseRow result_row(const MatrixResults & results, size_t c){
+    DenseRow r = { &results.data()[c * results.size2()] };
+    return r;
+  }
+  inline PackedRow result_row(const PackedResults & results, size_t c){
+    PackedRow r = { &results.bits[c * results.words] };
+    return r;
+  }
+
+  //
+  // A dataset ready for boosting
+  //
+  //  The weak classifier answers on the samples, run once by
+  //  ADA::prepare and shared by any number of ada_boost runs (round
+  //  counts, losses, trimming, ...): each run only does the rounds.
+  //
+  struct PreparedDataset {
+    PackedResults results;
+    Labels labels;
+
+    size_t size() const { return labels.size(); };
+  };
+
+  //
+  // Boosting losses of ADA::ada_boost
+  //
+  enum BoostAlgorithm {
+    DISCRETE_ADABOOST,  // alpha_t h_t (Freund, Schapire)
+    REAL_ADABOOST,      // half log-odds of each answer
+    GENTLE_ADABOOST,    // weighted mean label of each answer
+    LOGIT_BOOST         // Newton steps on the logistic loss,
+                        // robust to label noise
+  };
+
+  //
+  // Training knobs of ADA::ada_boost
+  //
+  struct BoostParameters {
+
+    // loss, the round engine is shared
+    BoostAlgorithm algorithm;
+
+    // keep log(D) in double precision next to D, so that the
+    // weights of well classified samples never underflow (useful
+    // for thousands of rounds; exponential losses only)
+    bool log_weights;
+
+    // weight trimming: the lightest samples holding at most this
+    // fraction of the total weight are left out of the error pass,
+    // and kept out while they hold less than twice that (0 = off,
+    // 0.1 is typical)
+    float trim_fraction;
+
+    // early stopping: stop after this many rounds without a lower
+    // validation error and keep the best round (0 = off, needs the
+    // validation overload of ada_boost)
+    unsigned int patience;
+
+    BoostParameters() :
+      algorithm(DISCRETE_ADABOOST),
+      log_weights(false),
+      trim_fraction(0),
+      patience(0) {};
+  };
+
   template <typename T>
   class ADA{
 
@@ -45,30 +281,150 @@ namespace DM_AG{
     //  @param data, the dataset to classify
     //  @param labels, classification labels (e.g. -1; +1}
     //  @param num_rounds, # boost iteration (default 100)
+    //  @param params, weights and trimming (see BoostParameters)
 
-    ClassificationResults
+    EnsembleModel
     ada_boost(typename Classifier<T>::CollectionClassifiers const &weak_classifiers,
 	      typename Classifier<T>::Data const & data,
 	      const Labels & labels,
-	      const unsigned int num_iterations){
+	      const unsigned int num_iterations,
+	      const BoostParameters & params = BoostParameters()){
 
-      // following notation
-      //
-      // http://en.wikipedia.org/wiki/AdaBoost
+      // init result matrix for weak classifiers
 
-      ClassificationResults alpha;
-      ClassificationResults D;
+      MatrixResults weak_classifiers_results(weak_classifiers.size(),
+					     labels.size());
+      run_classifiers(weak_classifiers, data, weak_classifiers_results);
 
-      size_t labels_size = labels.size();
-      size_t classifiers_size = weak_classifiers.size();
+      return run_rounds<MatrixResults>(weak_classifiers_results, labels,
+				       num_iterations, params, NULL, NULL);
+    };
 
-      D.resize(labels_size);           // D
-      alpha.resize(labels_size);       // alpha
+    //
+    // Apply Adaboost over a static pool
+    //
+    //  Same rounds; the weak classifiers are run without virtual
+    //  calls, so the precompute loops can be inlined and vectorized.
 
-      // init result matrix for weak classifiers
+    template <typename... Learners>
+    EnsembleModel
+    ada_boost(const ClassifierPool<T, Learners...> &weak_classifiers,
+	      typename Classifier<T>::Data const & data,
+	      const Labels & labels,
+	      const unsigned int num_iterations,
+	      const BoostParameters & params = BoostParameters()){
+
+      MatrixResults weak_classifiers_results(weak_classifiers.size(),
+					     labels.size());
+      weak_classifiers.run(data.data(), labels.size(),
+			   weak_classifiers_results);
+
+      return run_rounds<MatrixResults>(weak_classifiers_results, labels,
+				       num_iterations, params, NULL, NULL);
+    };
+
+    //
+    // Apply Adaboost with early stopping
+    //
+    //  The margins of a held-out set are updated every round; after
+    //  params.patience rounds without a lower validation error the
+    //  ensemble of the best round is returned.
+    //
+    //  @param validation_data, held-out samples
+    //  @param validation_labels, their labels (e.g. -1; +1}
+
+    EnsembleModel
+    ada_boost(typename Classifier<T>::CollectionClassifiers const &weak_classifiers,
+	      typename Classifier<T>::Data const & data,
+	      const Labels & labels,
+	      const unsigned int num_iterations,
+	      const BoostParameters & params,
+	      typename Classifier<T>::Data const & validation_data,
+	      const Labels & validation_labels){
+
+      MatrixResults weak_classifiers_results(weak_classifiers.size(),
+					     labels.size());
+      run_classifiers(weak_classifiers, data, weak_classifiers_results);
+
+      // Run each weak classifier on the held-out set, its margins
+      // follow the ensemble round by round
+      MatrixResults validation_results(weak_classifiers.size(),
+				       validation_labels.size());
+      run_classifiers(weak_classifiers, validation_data, validation_results);
+
+      return run_rounds(weak_classifiers_results, labels, num_iterations,
+			params, &validation_results, &validation_labels);
+    };
+
+    //
+    // Run the weak classifiers once over a dataset
+    //
+    //  @param weak_classifiers, a CollectionClassifiers or ClassifierPool
+    //  @param data, the dataset to classify
+    //  @param labels, classification labels (e.g. -1; +1}
+    //  @param dataset, filled with the packed answers and the labels
+    template <typename Pool>
+    void prepare(const Pool & weak_classifiers,
+		 typename Classifier<T>::Data const & data,
+		 const Labels & labels,
+		 PreparedDataset & dataset){
+
+      const size_t labels_size = labels.size();
+      dataset.labels = labels;
+      dataset.results.resize(weak_classifiers.size(), labels_size);
+
+      // a block of dense answers at a time, packed right away
+      MatrixResults block(weak_classifiers.size(),
+			  std::min(labels_size, PREPARE_BLOCK));
+      for (size_t first=0; first < labels_size; first += PREPARE_BLOCK){
+	size_t n = std::min(labels_size - first, PREPARE_BLOCK);
+	run_weak_classifiers(weak_classifiers, &data[first], n, block);
+	dataset.results.pack(block, first, n);
+      }
+    };
+
+    //
+    // Apply Adaboost over a prepared dataset
+    //
+    //  Only the rounds run; the weak classifiers are not called.
+    EnsembleModel
+    ada_boost(const PreparedDataset & dataset,
+	      const unsigned int num_iterations,
+	      const BoostParameters & params = BoostParameters()){
+
+      return run_rounds<PackedResults>(dataset.results, dataset.labels,
+				       num_iterations, params, NULL, NULL);
+    };
+
+    //
+    // Apply Adaboost over a prepared dataset with early stopping
+    //
+    //  @param validation, the prepared held-out set
+    EnsembleModel
+    ada_boost(const PreparedDataset & dataset,
+	      const unsigned int num_iterations,
+	      const BoostParameters & params,
+	      const PreparedDataset & validation){
+
+      return run_rounds(dataset.results, dataset.labels, num_iterations,
+			params, &validation.results, &validation.labels);
+    };
+
+  private:
+
+    // samples run per block by prepare()
+    static const size_t PREPARE_BLOCK = 4096;
+
+    //
+    // results(c, j) = weak classifier c on sample j
+    //
+    void
+    run_classifiers(typename Classifier<T>::CollectionClassifiers const &weak_classifiers,
+		    typename Classifier<T>::Data const & data,
+		    MatrixResults & weak_classifiers_results){
+
+      size_t labels_size = weak_classifiers_results.size2();
 
-      MatrixResults weak_classifiers_results(classifiers_size,
-					     labels_size);
       // Run each weak classifer
       //
       unsigned int num_current_classifier = 0;
@@ -92,11 +448,88 @@ namespace DM_AG{
 	//std::cout << std::endl;
 	num_current_classifier++;
       }
+    };
+
+    //
+    // The boosting rounds over precomputed weak classifier results
+    //
+    //  Every variant picks, each round, the weak classifier h_t with
+    //  the largest gain and adds one value per answer of it,
+    //  f_t(x) = v_t(h_t(x)), stored as alpha_t h_t(x) + bias_t.
+    //
+    //  Results is a dense MatrixResults or a PackedResults.
+    //
+    template <typename Results>
+    EnsembleModel
+    run_rounds(const Results & weak_classifiers_results,
+	       const Labels & labels,
+	       const unsigned int num_iterations,
+	       const BoostParameters & params,
+	       const Results * validation_results,
+	       const Labels * validation_labels){
+
+      // following notation
+      //
+      // http://en.wikipedia.org/wiki/AdaBoost
+      //
+      // and Friedman, Hastie, Tibshirani, "Additive logistic
+      // regression: a statistical view of boosting", 2000
+
+      EnsembleModel model;             // alphas
+      ClassificationResults D;
+
+      size_t labels_size = labels.size();
+
+      D.resize(labels_size);           // D
+
+      const bool early_stopping =
+	validation_results && validation_labels && params.patience > 0;
+      size_t validation_size = early_stopping ? validation_labels->size() : 0;
+
+      ClassificationResults validation_margin(validation_size, 0.0f);
+      size_t best_validation_errors = validation_size + 1;
+      unsigned int best_round = 0;
+      EnsembleModel best_model;
+
+      // LogitBoost: F(x_j), D = p (1 - p) and G = y* - p with
+      // p = 1 / (1 + exp(-2 F)) and y* = (y + 1) / 2
+      const bool logit = params.algorithm == LOGIT_BOOST;
+      std::vector<double> F;
+      ClassificationResults G;
 
       // Init boosters
       for (unsigned int j=0; j < labels_size; j++)
 	D[j] = (1.0) / labels_size;   // init D
 
+      // D is kept unnormalized: the distribution is D / z. In log
+      // mode D = exp(log_D - shift) and log_D / log_norm play the
+      // same role in the log domain.
+      double z = 1.0;
+      std::vector<double> log_D;
+      double log_norm = 0, max_log = 0;
+      if (params.log_weights && !logit){
+	max_log = -log((double)labels_size);
+	log_D.assign(labels_size, max_log);
+      }
+      if (logit){
+	F.assign(labels_size, 0.0);
+	G.resize(labels_size);
+	for (unsigned int j=0; j < labels_size; j++){
+	  D[j] = 0.25f;
+	  G[j] = labels[j] > 0 ? 0.5f : -0.5f;
+	}
+	z = 0.25 * labels_size;
+      }
+
+      // Weight trimming (Friedman, Hastie, Tibshirani): the rounds
+      // look at the active samples only, their answers, labels and
+      // weights copied back to back (see ActiveSet)
+      const bool trimming = params.trim_fraction > 0;
+      ActiveSet active;
+
+      const int * y = labels.empty() ? NULL : &labels[0];
+      const float * g = logit ? &G[0] : NULL;
+
       // for the maximum rounds
       //
       for (unsigned int round=0;
@@ -104,96 +537,553 @@ namespace DM_AG{
 
 	//std::cout << "Iteration" << round << std::endl;
 
-	float min_error=labels_size;
-	unsigned int best_classifier = 0;
+	// the set leaves out at most trim_fraction of z when built and
+	// is kept while the weight it skips stays below twice that,
+	// refreshed every TRIM_REFRESH rounds to drop the samples that
+	// got light since
+	bool trimmed = false;
+	if (trimming){
+	  const double skipped = !active.built() ? z :
+	    active.trims() ? z - active.gather(&D[0], g) : 0;
+	  if (skipped > 2 * params.trim_fraction * z ||
+	      round - active.round >= TRIM_REFRESH){
+	    active.build(weak_classifiers_results, labels, &D[0],
+			 params.trim_fraction * z, round);
+	    if (active.trims())
+	      active.gather(&D[0], g);
+	  }
+	  trimmed = active.trims();
+	}
 
-	//
-	// for each classifier
-	for (num_current_classifier = 0;
-	     num_current_classifier < classifiers_size;
-	     num_current_classifier++){
+	unsigned int best_classifier;
+	RoundTotals totals;
+	ClassifierSums best_sums;
+	double v_pos, v_neg;       // values of the answers h = +1 / -1
+
+	if (trimmed){
+	  best_classifier = pick(active.results, params.algorithm,
+				 &active.labels[0], &active.D[0],
+				 logit ? &active.G[0] : NULL, active.size(),
+				 totals, best_sums);
+
+	  // the skipped weight s lowers the gain over all samples by
+	  // at most s / z (discrete AdaBoost, about as much for the
+	  // others): only a pick that close to no edge, or perfect on
+	  // the active samples, is checked over all of them, and
+	  // replaced by the pick over all of them if it fails. The
+	  // values and D_{t+1} keep the sums over the active samples,
+	  // so that the pick is even there next round.
+	  const double s = z - totals.total;
+	  const double gain = rule(params.algorithm, totals, best_sums,
+				   v_pos, v_neg);
+	  if (gain <= MIN_EDGE + s / z ||
+	      best_sums.miss <= MIN_ERROR * totals.total){
+	    const RoundTotals all_totals =
+	      round_totals(y, &D[0], g, labels_size);
+	    const ClassifierSums all_sums =
+	      classifier_sums(result_row(weak_classifiers_results,
+					 best_classifier),
+			      y, &D[0], g, labels_size);
+	    if (rule(params.algorithm, all_totals, all_sums,
+		     v_pos, v_neg) <= MIN_EDGE)
+	      trimmed = false;
+	    else if (best_sums.miss <= MIN_ERROR * totals.total){
+	      // perfect on the active samples only
+	      totals = all_totals;
+	      best_sums = all_sums;
+	    }
+	  }
+	}
+	if (!trimmed)
+	  best_classifier = pick(weak_classifiers_results, params.algorithm,
+				 y, &D[0], g, labels_size, totals, best_sums);
 
-	  float error=0;
+	auto best = result_row(weak_classifiers_results, best_classifier);
+	const double max_gain = rule(params.algorithm, totals, best_sums,
+				     v_pos, v_neg);
 
-	  //
-	  // for each feature
-	  for (unsigned int j=0; j < labels_size; j++)
-	    if (weak_classifiers_results(num_current_classifier,
-					 j) != labels[j])
-	      error += D[j];
+	/*std::cout << "\tbest_classifier=" << best_classifier
+		  << " gain=" << max_gain << std::endl;*/
+
+	if (max_gain <= MIN_EDGE)    // GOOD enough
+	  break;                     // condition
+
+	// a perfect classifier (only discrete AdaBoost has unbounded
+	// values) leaves nothing to reweight
+	const bool perfect = params.algorithm == DISCRETE_ADABOOST &&
+	  best_sums.miss <= MIN_ERROR * totals.total;
+
+	// a_t, bias_t
+	model.add(best_classifier, (v_pos - v_neg) / 2);
+	model.bias += (v_pos + v_neg) / 2;
+
+	// held-out margins and error of the ensemble so far
+	if (early_stopping){
+	  auto validation_best = result_row(*validation_results, best_classifier);
+	  size_t errors = 0;
+	  for (unsigned int j=0; j < validation_size; j++){
+	    validation_margin[j] +=
+	      validation_best.positive(j) ? v_pos : v_neg;
+	    if ((validation_margin[j] >= 0 ? 1 : -1) != (*validation_labels)[j])
+	      errors++;
+	  }
 
-	  if (error<min_error){
-	    min_error = error; // this is the best observed
-	    best_classifier = num_current_classifier;
+	  if (errors < best_validation_errors){
+	    best_validation_errors = errors;
+	    best_round = round;
+	    best_model = model;
 	  }
-	}// each classifier
+	  else if (round - best_round >= params.patience)
+	    break;
+	}
 
-	/*std::cout << "\tbest_classifier=" << best_classifier
-		  << " error=" << min_error << std::endl;*/
+	if (perfect)             // nothing left
+	  break;                 // to reweight
 
-	if (min_error >= 0.5)    // GOOD enough
-	  break;                 // condition
+	double sum = 0;
 
-	// a_t
-	alpha[best_classifier] =
-	  log((1.0f - min_error)/min_error)/2;
+	if (logit){
 
-	// D_{t+1}
-	ClassificationResults D_1(D);
+	  // F += f_t, then the Newton weights and responses
+	  for (unsigned int j=0; j < labels_size; j++){
+	    const double f = F[j] += best.positive(j) ? v_pos : v_neg;
+	    const double p = 1.0 / (1.0 + exp(-2.0 * f));
+	    D[j] = std::max(p * (1.0 - p), MIN_LOGIT_WEIGHT);
+	    G[j] = (labels[j] > 0 ? 1.0 : 0.0) - p;
+	    sum += D[j];
+	  }
+	  z = sum;
+	  continue;
+	}
 
-	// update D_{t+1}
-	float z = 0;
-	for (unsigned int j=0; j < labels_size; j++){
+	// D_{t+1} = D_t exp(-y f_t) / Z_t, one factor per (answer,
+	// label) pair.
+	//
+	// Discrete AdaBoost: Z_t = 2 sqrt(e (1 - e)), the factor is
+	// 1 / (2 (1 - e)) on hits and 1 / (2 e) on misses: no exp().
+	// Dividing by the current sum z renormalizes in the same pass.
+	double factor[4];   // [2 (h > 0) + (y > 0)]
+	if (params.algorithm == DISCRETE_ADABOOST){
+	  const double e = std::max(best_sums.miss / totals.total, MIN_ERROR);
+	  const double hit = 1.0 / (2.0 * (1.0 - e));
+	  const double miss = 1.0 / (2.0 * e);
+	  factor[0] = hit;  factor[1] = miss;
+	  factor[2] = miss; factor[3] = hit;
+	}
+	else{
+	  factor[0] = exp(v_neg);  factor[1] = exp(-v_neg);
+	  factor[2] = exp(v_pos);  factor[3] = exp(-v_pos);
+	}
 
-	  D_1[j] *=
-	    exp(-alpha[best_classifier] *
-		labels[j] *
-		weak_classifiers_results(best_classifier, j));
-	  z+=D_1[j];
+	if (!params.log_weights){
+
+	  float f_z[4];
+	  for (int k=0; k < 4; k++)
+	    f_z[k] = factor[k] / z;
+	  for (unsigned int j=0; j < labels_size; j++){
+	    D[j] *= f_z[2 * best.positive(j) + (labels[j] > 0)];
+	    sum += D[j];
+	  }
+	}
+	else{
+
+	  // log_D - log_norm stays a log probability; D is rebuilt
+	  // relative to an upper bound of the new maximum so that
+	  // exp() never overflows and the largest weights never flush
+	  double log_f[4];
+	  double max_f = -HUGE_VAL;
+	  for (int k=0; k < 4; k++){
+	    log_f[k] = log(factor[k]) - log_norm;
+	    max_f = std::max(max_f, log_f[k]);
+	  }
+	  const double shift = max_log + max_f;
+	  double new_max = -HUGE_VAL;
+	  for (unsigned int j=0; j < labels_size; j++){
+	    const double l = log_D[j] +=
+	      log_f[2 * best.positive(j) + (labels[j] > 0)];
+	    new_max = std::max(new_max, l);
+	    // below FLT_MIN: skip exp() and denormal arithmetic
+	    D[j] = l - shift > LOG_FLT_MIN ? exp(l - shift) : 0.0f;
+	    sum += D[j];
+	  }
+	  max_log = new_max;
+	  log_norm = shift + log(sum);
 	}
 
-	// normalize so that it is a prob distribution
-	for (unsigned int j=0; j < labels_size; j++)
-	  D[j] = D_1[j]/z;
+	z = sum;
 
       } // all the rounds.
 
-      return alpha;
+      // drop the rounds after the best validation error
+      if (early_stopping && best_validation_errors <= validation_size)
+	return best_model;
+
+      return model;
+    };
+
+    // weight of the active samples, of those labelled +1 and (for
+    // LogitBoost) their total response
+    struct RoundTotals {
+      double total, positive, response;
+    };
+
+    // per weak classifier: weight it misclassifies, weight it
+    // answers +1 on and the response there
+    struct ClassifierSums {
+      double miss, pos, response_pos;
+    };
+
+    static RoundTotals round_totals(const int * y, const float * D,
+				    const float * G, size_t n){
+      RoundTotals t = { 0, 0, 0 };
+      for (size_t j=0; j < n; j++){
+	t.total += D[j];
+	t.positive += y[j] > 0 ? D[j] : 0.0f;
+	if (G)
+	  t.response += G[j];
+      }
+      return t;
+    };
+
+    // the hot loop: two (three) branchless sums per sample over n
+    // contiguous samples, all of them or the active ones; Row is a
+    // DenseRow or a PackedRow
+    template <typename Row>
+    static ClassifierSums classifier_sums(const Row & h, const int * y,
+					  const float * D, const float * G,
+					  size_t n){
+      double miss = 0, pos = 0, response_pos = 0;
+      for (size_t j=0; j < n; j++){
+	const bool positive = h.positive(j);
+	miss += positive != (y[j] > 0) ? D[j] : 0.0f;
+	pos += positive ? D[j] : 0.0f;
+      }
+      if (G)
+	for (size_t j=0; j < n; j++)
+	  response_pos += h.positive(j) ? G[j] : 0.0f;
+      ClassifierSums s = { miss, pos, response_pos };
+      return s;
+    };
+
+    // the weak classifier of largest gain over n samples, with the
+    // totals and its sums
+    template <typename Results>
+    static unsigned int pick(const Results & results, BoostAlgorithm algorithm,
+			     const int * y, const float * D, const float * G,
+			     size_t n, RoundTotals & totals,
+			     ClassifierSums & best_sums){
+
+      totals = round_totals(y, D, G, n);
+      double max_gain = -HUGE_VAL;
+      unsigned int best_classifier = 0;
+      double v_pos, v_neg;
+
+      //
+      // for each classifier
+      for (unsigned int num_current_classifier = 0;
+	   num_current_classifier < num_classifiers(results);
+	   num_current_classifier++){
+
+	ClassifierSums sums =
+	  classifier_sums(result_row(results, num_current_classifier),
+			  y, D, G, n);
+	double gain = rule(algorithm, totals, sums, v_pos, v_neg);
+
+	if (gain > max_gain){
+	  max_gain = gain;  // this is the best observed
+	  best_classifier = num_current_classifier;
+	  best_sums = sums;
+	}
+      }// each classifier
+
+      return best_classifier;
+    };
+
+    //
+    // Gain of a weak classifier and the values of its answers
+    //
+    //  From the sums, W[h][y] is the weight answered h with label y.
+    //  The gain is normalized by the total weight; rounds stop when
+    //  the best gain is ~ 0.
+    //
+    static double rule(BoostAlgorithm algorithm,
+		       const RoundTotals & t, const ClassifierSums & s,
+		       double & v_pos, double & v_neg){
+
+      const double w_pp = (s.pos + t.positive - s.miss) / 2;
+      const double w_pm = s.pos - w_pp;            // h = +1, y = -1
+      const double w_mp = t.positive - w_pp;       // h = -1, y = +1
+      const double w_mm = t.total - t.positive - w_pm;
+
+      switch (algorithm){
+
+      case REAL_ADABOOST:{
+	// v(h) = log(W[h][+] / W[h][-]) / 2, gain = 1 - Z_t; eps ~ 1/N
+	// keeps pure answers finite (Schapire, Singer)
+	const double eps = t.total * REAL_SMOOTHING;
+	v_pos = 0.5 * log((std::max(w_pp, 0.0) + eps) / (std::max(w_pm, 0.0) + eps));
+	v_neg = 0.5 * log((std::max(w_mp, 0.0) + eps) / (std::max(w_mm, 0.0) + eps));
+	return 1.0 - 2.0 * (sqrt(std::max(w_pp * w_pm, 0.0)) +
+			    sqrt(std::max(w_mp * w_mm, 0.0))) / t.total;
+      }
+
+      case GENTLE_ADABOOST:{
+	// weighted least squares: v(h) = weighted mean of y
+	const double n_pos = w_pp + w_pm, n_neg = w_mp + w_mm;
+	v_pos = n_pos > 0 ? (w_pp - w_pm) / n_pos : 0;
+	v_neg = n_neg > 0 ? (w_mp - w_mm) / n_neg : 0;
+	return ((n_pos > 0 ? (w_pp - w_pm) * v_pos : 0) +
+		(n_neg > 0 ? (w_mp - w_mm) * v_neg : 0)) / t.total;
+      }
+
+      case LOGIT_BOOST:{
+	// Newton step: v(h) = sum G / sum D over the answer, clipped
+	const double d_pos = s.pos, d_neg = t.total - s.pos;
+	const double r_pos = s.response_pos, r_neg = t.response - s.response_pos;
+	v_pos = d_pos > 0 ? r_pos / d_pos : 0;
+	v_neg = d_neg > 0 ? r_neg / d_neg : 0;
+	const double gain = (r_pos * v_pos + r_neg * v_neg) / t.total;
+	v_pos = 0.5 * std::max(-MAX_RESPONSE, std::min(MAX_RESPONSE, v_pos));
+	v_neg = 0.5 * std::max(-MAX_RESPONSE, std::min(MAX_RESPONSE, v_neg));
+	return gain;
+      }
+
+      case DISCRETE_ADABOOST:
+      default:{
+	// a_t = log((1 - e) / e) / 2
+	const double e = std::max(s.miss / t.total, MIN_ERROR);
+	v_pos = log((1.0 - e) / e) / 2;
+	v_neg = -v_pos;
+	return 0.5 - s.miss / t.total;
+      }
+      }
+    };
+
+    struct WeightIndex {
+      float w;
+      unsigned int j;
+      bool operator<(const WeightIndex & other) const { return w < other.w; };
+    };
+
+    //
+    // Weighted quantile: moves the lightest samples holding at most
+    // budget of the weight to the front and returns their number
+    //
+    //  nth_element halves the range that holds the cut each step,
+    //  O(n) expected.
+    //
+    static size_t lightest(std::vector<WeightIndex> & w, double budget){
+
+      size_t lo = 0, hi = w.size();
+      double below = 0;        // weight of w[0, lo), lighter than w[lo, hi)
+      while (hi - lo > 32){
+	const size_t mid = lo + (hi - lo) / 2;
+	std::nth_element(w.begin() + lo, w.begin() + mid, w.begin() + hi);
+	double mass = 0;
+	for (size_t i = lo; i < mid; i++)
+	  mass += w[i].w;
+	if (below + mass <= budget){
+	  below += mass;
+	  lo = mid;
+	}
+	else
+	  hi = mid;
+      }
+      std::sort(w.begin() + lo, w.begin() + hi);
+      while (lo < hi && below + w[lo].w <= budget)
+	below += w[lo++].w;
+      return lo;
+    };
+
+    //
+    // The samples a trimmed round looks at
+    //
+    //  The heaviest samples, whose answers are packed and labels
+    //  copied by build(), and weights by gather() each round, so the
+    //  error pass runs over contiguous arrays as it does untrimmed.
+    //
+    struct ActiveSet {
+
+      std::vector<unsigned int> index;   // sample of each active slot
+      PackedResults results;
+      Labels labels;
+      ClassificationResults D, G;
+      unsigned int round;                // of the last build
+      size_t num_samples;
+
+      ActiveSet() : round(0), num_samples(0) {};
+
+      bool built() const { return num_samples > 0; };
+      bool trims() const { return !index.empty() && index.size() < num_samples; };
+      size_t size() const { return index.size(); };
+
+      // keeps all the samples but the lightest holding at most budget
+      template <typename Results>
+      void build(const Results & all, const Labels & all_labels,
+		 const float * all_D, double budget, unsigned int at_round){
+
+	num_samples = all_labels.size();
+	round = at_round;
+	std::vector<WeightIndex> by_weight(num_samples);
+	for (unsigned int j=0; j < num_samples; j++){
+	  by_weight[j].w = all_D[j];
+	  by_weight[j].j = j;
+	}
+	const size_t dropped = lightest(by_weight, budget);
+
+	std::vector<char> keep(num_samples, 1);
+	for (size_t i=0; i < dropped; i++)
+	  keep[by_weight[i].j] = 0;
+	index.clear();
+	for (unsigned int j=0; j < num_samples; j++)
+	  if (keep[j])
+	    index.push_back(j);
+	if (!trims())
+	  return;
+
+	const size_t m = index.size();
+	results.resize(num_classifiers(all), m);
+	for (size_t c=0; c < results.num_classifiers; c++){
+	  auto h = result_row(all, c);
+	  uint64_t * row = &results.bits[c * results.words];
+	  for (size_t a=0; a < m; a++)
+	    row[a >> 6] |= uint64_t(h.positive(index[a])) << (a & 63);
+	}
+	labels.resize(m);
+	for (size_t a=0; a < m; a++)
+	  labels[a] = all_labels[index[a]];
+	D.resize(m);
+	G.resize(m);
+      };
+
+      // copies the current weights (and responses), returns the
+      // active weight
+      double gather(const float * all_D, const float * all_G){
+	double kept = 0;
+	for (size_t a=0; a < index.size(); a++)
+	  kept += D[a] = all_D[index[a]];
+	if (all_G)
+	  for (size_t a=0; a < index.size(); a++)
+	    G[a] = all_G[index[a]];
+	return kept;
+      };
     };
 
+    // rounds between two rebuilds of the active set at most
+    static const unsigned int TRIM_REFRESH = 16;
+
+    // error of a perfect weak classifier, keeps alpha finite
+    static constexpr double MIN_ERROR = 1e-10;
+    // rounds whose best error is this close to 0.5 get alpha ~ 0
+    // and would leave D unchanged
+    static constexpr double MIN_EDGE = 1e-7;
+    // log(FLT_MIN), smaller weights are flushed to zero
+    static constexpr double LOG_FLT_MIN = -87.3;
+    // Real AdaBoost smoothing of W[h][y], relative to the total
+    static constexpr double REAL_SMOOTHING = 1e-4;
+    // LogitBoost: bounds of the Newton response and of p (1 - p)
+    static constexpr double MAX_RESPONSE = 4.0;
+    static constexpr double MIN_LOGIT_WEIGHT = 1e-12;
+
   }; // class ADA
 
+  template <typename T>
+  const size_t ADA<T>::PREPARE_BLOCK;
+  template <typename T>
+  const unsigned int ADA<T>::TRIM_REFRESH;
+  template <typename T>
+  constexpr double ADA<T>::MIN_ERROR;
+  template <typename T>
+  constexpr double ADA<T>::MIN_EDGE;
+  template <typename T>
+  constexpr double ADA<T>::LOG_FLT_MIN;
+  template <typename T>
+  constexpr double ADA<T>::REAL_SMOOTHING;
+  template <typename T>
+  constexpr double ADA<T>::MAX_RESPONSE;
+  template <typename T>
+  constexpr double ADA<T>::MIN_LOGIT_WEIGHT;
+
+  // margins[i] += alpha * h_c(samples[i]), virtual pool
+  template <typename T>
+  void accumulate_votes(const boost::ptr_vector<Classifier<T> > & pool,
+			size_t c, float alpha, const T * samples, size_t n,
+			float * margins){
+
+    const Classifier<T> & h = pool[c];
+    for (size_t i = 0; i < n; i++)
+      margins[i] += alpha * h.analyze(samples[i]);
+  }
+
   //
   // A strong classifier is a linear comb of weak class
   //
-  template <typename T>
+  //  Pool is the virtual CollectionClassifiers or a ClassifierPool
+  //
+  template <typename T,
+	    typename Pool = typename Classifier<T>::CollectionClassifiers>
   class StrongClassifier : public Classifier<T>
   {
   private:
-    ClassificationResults & weigths_;
-    size_t num_classifiers_;
-    typename Classifier<T>::CollectionClassifiers * classifiers_;
-    Labels & labels_;
+    EnsembleModel model_;      // empty when built on a view
+    EnsembleView view_;        // what is scored, into model_ or not
+    bool owned_;
+    const Pool * classifiers_;
+
+    // samples scored per tile (margins stay in L1) and the
+    // smallest slice of a batch worth handing to a thread
+    static const size_t BATCH_TILE = 256;
+    static const size_t BATCH_GRAIN = 16384;
+
+    // margins for one tile-sized or larger block, learner by
+    // learner so each weak classifier runs over the whole block
+    void score_block(const T * samples, size_t n, float * margins) const {
+
+      std::fill(margins, margins + n, view_.bias);
+      for (size_t t=0; t < view_.size(); t++)
+	accumulate_votes(*classifiers_, view_.learners[t], view_.alphas[t],
+			 samples, n, margins);
+    }
 
   public:
-    StrongClassifier(ClassificationResults & w,
-		     typename Classifier<T>::CollectionClassifiers * cls,
-		     Labels & labels) :
-      weigths_(w),
-      num_classifiers_(cls->size()),
-      classifiers_(cls),
-      labels_(labels){};
+    // keeps its own copy of the model
+    StrongClassifier(const EnsembleModel & model,
+		     const Pool * cls) :
+      model_(model),
+      view_(EnsembleView::of(model_)),
+      owned_(true),
+      classifiers_(cls){};
+
+    // scores a model owned by someone else, e.g. a MappedEnsemble,
+    // without copying it
+    StrongClassifier(const EnsembleView & view,
+		     const Pool * cls) :
+      view_(view),
+      owned_(false),
+      classifiers_(cls){};
+
+    StrongClassifier(const StrongClassifier & other) :
+      model_(other.model_),
+      view_(other.owned_ ? EnsembleView::of(model_) : other.view_),
+      owned_(other.owned_),
+      classifiers_(other.classifiers_){};
+
+    StrongClassifier & operator=(const StrongClassifier & other){
+      model_ = other.model_;
+      view_ = other.owned_ ? EnsembleView::of(model_) : other.view_;
+      owned_ = other.owned_;
+      classifiers_ = other.classifiers_;
+      return *this;
+    };
+
+    const EnsembleView & model() const { return view_; };
 
     // analyze
     //
     int analyze(const T & feature) const {
 
       float val=0;
-      for (unsigned int current_classifier=0;
-	   current_classifier < num_classifiers_;
-	   current_classifier++)
-	val += weigths_[current_classifier] *
-	  (*classifiers_)[current_classifier].analyze(feature);
+      score_block(&feature, 1, &val);
 
       if (val>=0)
 	return 1;  // label +1
@@ -201,6 +1091,103 @@ namespace DM_AG{
 	return -1; // label -1
     };
 
+    // decision_function
+    //
+    //  Weighted vote sum(w_t * h_t(x)) for a contiguous batch of samples.
+    //  Large batches are split across threads.
+    //
+    //  @param samples, n_samples samples stored back to back
+    //  @param n_samples, # samples in the batch
+    //  @param margins, caller-provided buffer of n_samples floats
+    //  @param num_threads, # worker threads (0 = all cores)
+    void decision_function(const T * samples, size_t n_samples,
+			   float * margins,
+			   unsigned int num_threads = 0) const {
+
+      const StrongClassifier * self = this;
+      parallelFor(n_samples, BATCH_GRAIN, num_threads,
+		  [=](size_t begin, size_t end){
+		    for (size_t i = begin; i < end; i += BATCH_TILE){
+		      size_t n = std::min<size_t>(BATCH_TILE, end - i);
+		      self->score_block(samples + i, n, margins + i);
+		    }
+		  });
+    };
+
+    // predict
+    //
+    //  Labels (+1 / -1) for a contiguous batch of samples.
+    //
+    //  @param labels, caller-provided buffer of n_samples ints
+    void predict(const T * samples, size_t n_samples,
+		 int * labels,
+		 unsigned int num_threads = 0) const {
+
+      const StrongClassifier * self = this;
+      parallelFor(n_samples, BATCH_GRAIN, num_threads,
+		  [=](size_t begin, size_t end){
+		    float margins[BATCH_TILE];
+		    for (size_t i = begin; i < end; i += BATCH_TILE){
+		      size_t n = std::min<size_t>(BATCH_TILE, end - i);
+		      self->score_block(samples + i, n, margins);
+		      for (size_t j = 0; j < n; j++)
+			labels[i + j] = margins[j] >= 0 ? 1 : -1;
+		    }
+		  });
+    };
+
+    // Row-major feature matrix overloads, T = FeatureRow<V>
+    //
+    //  @param matrix, n_rows x n_cols values, one sample per row
+    template <typename V>
+    void decision_function(const V * matrix, size_t n_rows, size_t n_cols,
+			   float * margins,
+			   unsigned int num_threads = 0) const {
+
+      static_assert(std::is_same<T, FeatureRow<V> >::value,
+		    "matrix input needs a StrongClassifier<FeatureRow<V> >");
+
+      const StrongClassifier * self = this;
+      parallelFor(n_rows, BATCH_GRAIN, num_threads,
+		  [=](size_t begin, size_t end){
+		    T rows[BATCH_TILE];
+		    for (size_t i = begin; i < end; i += BATCH_TILE){
+		      size_t n = std::min<size_t>(BATCH_TILE, end - i);
+		      for (size_t j = 0; j < n; j++){
+			rows[j].values = matrix + (i + j) * n_cols;
+			rows[j].num_features = n_cols;
+		      }
+		      self->score_block(rows, n, margins + i);
+		    }
+		  });
+    };
+
+    template <typename V>
+    void predict(const V * matrix, size_t n_rows, size_t n_cols,
+		 int * labels,
+		 unsigned int num_threads = 0) const {
+
+      static_assert(std::is_same<T, FeatureRow<V> >::value,
+		    "matrix input needs a StrongClassifier<FeatureRow<V> >");
+
+      const StrongClassifier * self = this;
+      parallelFor(n_rows, BATCH_GRAIN, num_threads,
+		  [=](size_t begin, size_t end){
+		    T rows[BATCH_TILE];
+		    float margins[BATCH_TILE];
+		    for (size_t i = begin; i < end; i += BATCH_TILE){
+		      size_t n = std::min<size_t>(BATCH_TILE, end - i);
+		      for (size_t j = 0; j < n; j++){
+			rows[j].values = matrix + (i + j) * n_cols;
+			rows[j].num_features = n_cols;
+		      }
+		      self->score_block(rows, n, margins);
+		      for (size_t j = 0; j < n; j++)
+			labels[i + j] = margins[j] >= 0 ? 1 : -1;
+		    }
+		  });
+    };
+
     void performance(){
 
 
@@ -209,59 +1196,1205 @@ namespace DM_AG{
 
   }; // strong classifier
 
+  template <typename T, typename Pool>
+  const size_t StrongClassifier<T, Pool>::BATCH_TILE;
+  template <typename T, typename Pool>
+  const size_t StrongClassifier<T, Pool>::BATCH_GRAIN;
+
 } // namespace
 
 #endif
 
 
 
+/*************** SAMME *******************/
+#ifndef ADA_SAMME
+#define ADA_SAMME 1
 
+namespace DM_AG{
 
-/*************** WEAK_CLASSIFIER *******************/
+  //
+  // A multi-class ensemble (SAMME / SAMME.R)
+  //
+  //  Learner t adds votes(t)[o * K + k] to the score of class k when
+  //  its weak classifier answers o. A weak classifier picked in
+  //  several rounds is stored once with its votes summed.
+  //
+  struct MultiClassModel {
+
+    unsigned int num_classes;               // K
+    std::vector<unsigned int> learners;     // index in the classifier pool
+    std::vector<float> votes;               // learners.size() x K x K
+
+    MultiClassModel() : num_classes(0) {};
+
+    size_t size() const { return learners.size(); };
+
+    const float * table(size_t t) const {
+      return &votes[t * num_classes * num_classes];
+    };
+  };
+
+  enum SammeAlgorithm {
+    SAMME_DISCRETE,  // alpha_t for the answered class
+    SAMME_REAL       // SAMME.R, log-probabilities of the answer's
+                     // weighted class distribution
+  };
+
+  template <typename T>
+  class SAMME{
+
+  public:
+
+    //
+    // Apply SAMME / SAMME.R
+    //
+    //  Trains one ensemble for all classes (no one-vs-rest).
+    //
+    //  @param weak_classifiers, a pool (see run_weak_classifier)
+    //         answering class ids in [0, num_classes)
+    //  @param data, the dataset to classify
+    //  @param labels, class ids in [0, num_classes)
+    //  @param num_classes, K
+    //  @param num_iterations, # boost iterations
+    //  @param model, the ensemble
+    //  @param algorithm, SAMME_DISCRETE or SAMME_REAL
+    //  @return false, with an empty model, if K < 2 or a label or a
+    //  weak classifier answer is not in [0, K)
+
+    template <typename Pool>
+    bool
+    samme_boost(const Pool & weak_classifiers,
+		typename Classifier<T>::Data const & data,
+		const Labels & labels,
+		const unsigned int num_classes,
+		const unsigned int num_iterations,
+		MultiClassModel & model,
+		const SammeAlgorithm algorithm = SAMME_DISCRETE){
+
+      // following notation
+      //
+      // Zhu, Zou, Rosset, Hastie, "Multi-class AdaBoost", 2009
+
+      model = MultiClassModel();
+      model.num_classes = num_classes;
+
+      const size_t K = num_classes;
+      const size_t KK = K * K;
+      size_t labels_size = labels.size();
+      size_t classifiers_size = weak_classifiers.size();
+
+      if (K < 2)
+	return false;
+      for (unsigned int j=0; j < labels_size; j++)
+	if (labels[j] < 0 || labels[j] >= (int)K)
+	  return false;
+      if (labels_size == 0 || classifiers_size == 0)
+	return true;
+
+      // Run each weak classifer
+      //
+      MatrixResults weak_classifiers_results(classifiers_size,
+					     labels_size);
+      int * results = &weak_classifiers_results.data()[0];
+      for (unsigned int c=0; c < classifiers_size; c++)
+	run_weak_classifier(weak_classifiers, c, &data[0], labels_size,
+			    results + c * labels_size);
+      for (size_t i=0; i < classifiers_size * labels_size; i++)
+	if (results[i] < 0 || results[i] >= (int)K)
+	  return false;
+
+      // Init boosters, D / z is the distribution (see ADA::ada_boost)
+      ClassificationResults D(labels_size, 1.0f / labels_size);
+      double z = 1.0;
+
+      // weighted mass of each (answer, class) pair, and per pair the
+      // votes and the D multiplier of the candidate weak classifier
+      std::vector<double> mass(KK);
+      std::vector<float> votes(KK), best_votes(KK);
+      std::vector<double> factor(KK), best_factor(KK);
+      std::vector<int> slot(classifiers_size, -1);
+
+      // for the maximum rounds
+      //
+      for (unsigned int round=0;
+	   round < num_iterations; round++){
+
+	double min_loss = HUGE_VAL;
+	unsigned int best_classifier = 0;
+
+	//
+	// for each classifier
+	for (unsigned int c=0; c < classifiers_size; c++){
+
+	  const int * h = results + c * labels_size;
+	  std::fill(mass.begin(), mass.end(), 0.0);
+	  for (unsigned int j=0; j < labels_size; j++)
+	    mass[h[j] * K + labels[j]] += D[j];
+
+	  // SAMME: weighted error, SAMME.R: next round's sum of D
+	  double loss = 0;
+	  if (algorithm == SAMME_DISCRETE){
+	    for (size_t o=0; o < K; o++)
+	      for (size_t k=0; k < K; k++)
+		if (o != k)
+		  loss += mass[o * K + k];
+	  }
+	  else
+	    loss = real_votes(mass, K, votes, factor);
+
+	  if (loss < min_loss){
+	    min_loss = loss;    // this is the best observed
+	    best_classifier = c;
+	    best_votes.swap(votes);
+	    best_factor.swap(factor);
+	  }
+	}// each classifier
+
+	min_loss /= z;
+	bool perfect = false;
+
+	if (algorithm == SAMME_DISCRETE){
+
+	  // no better than guessing
+	  if (min_loss >= 1.0 - 1.0 / K - MIN_EDGE)
+	    break;
+
+	  perfect = min_loss <= MIN_ERROR;
+	  if (perfect)
+	    min_loss = MIN_ERROR;
+
+	  // a_t = log((1 - e) / e) + log(K - 1)
+	  const double alpha =
+	    log((1.0 - min_loss) / min_loss) + log(K - 1.0);
+
+	  // hits keep their weight, misses get e^a_t, then normalize
+	  const double norm = (1.0 - min_loss) + min_loss * exp(alpha);
+	  for (size_t o=0; o < K; o++)
+	    for (size_t k=0; k < K; k++){
+	      best_votes[o * K + k] = o == k ? alpha : 0;
+	      best_factor[o * K + k] = (o == k ? 1.0 : exp(alpha)) / norm;
+	    }
+	}
+	else{
+
+	  // the weak classifier does not lower the loss
+	  if (min_loss >= 1.0 - MIN_EDGE)
+	    break;
+
+	  for (size_t p=0; p < KK; p++)
+	    best_factor[p] /= min_loss;
+	}
+
+	// merge the round into the ensemble
+	if (slot[best_classifier] < 0){
+	  slot[best_classifier] = model.learners.size();
+	  model.learners.push_back(best_classifier);
+	  model.votes.resize(model.votes.size() + KK, 0.0f);
+	}
+	float * model_votes = &model.votes[slot[best_classifier] * KK];
+	for (size_t p=0; p < KK; p++)
+	  model_votes[p] += best_votes[p];
+
+	if (perfect)             // nothing left
+	  break;                 // to reweight
+
+	// D_{t+1}, one fused in-place pass
+	std::vector<float> f(best_factor.begin(), best_factor.end());
+	for (size_t p=0; p < KK; p++)
+	  f[p] /= z;
+
+	const int * best = results + best_classifier * labels_size;
+	double sum = 0;
+	for (unsigned int j=0; j < labels_size; j++){
+	  D[j] *= f[best[j] * K + labels[j]];
+	  sum += D[j];
+	}
+	z = sum;
+
+      } // all the rounds.
+
+      return true;
+    };
+
+  private:
+
+    // error of a perfect weak classifier, keeps alpha finite
+    static constexpr double MIN_ERROR = 1e-10;
+    // losses this close to chance stop training
+    static constexpr double MIN_EDGE = 1e-7;
+    // class probabilities are clipped to this
+    static constexpr double MIN_PROB = 1e-7;
+
+    //
+    // SAMME.R votes of a weak classifier
+    //
+    //  p(k|o) is the weighted class distribution of answer o,
+    //  votes(o, k) = (K - 1) (log p(k|o) - mean_j log p(j|o)) and a
+    //  sample of class c answered o has its weight multiplied by
+    //  exp(-votes(o, c) / (K - 1)).
+    //
+    //  @return sum of the weights after that multiplication
+    static double real_votes(const std::vector<double> & mass, size_t K,
+			     std::vector<float> & votes,
+			     std::vector<double> & factor){
+
+      double loss = 0;
+      std::vector<double> log_p(K);
+
+      for (size_t o=0; o < K; o++){
+
+	const double * m = &mass[o * K];
+	double total = 0;
+	for (size_t k=0; k < K; k++)
+	  total += m[k];
+
+	double mean = 0;
+	for (size_t k=0; k < K; k++){
+	  double p = total > 0 ? m[k] / total : 1.0 / K;
+	  log_p[k] = log(std::max(p, MIN_PROB));
+	  mean += log_p[k];
+	}
+	mean /= K;
+
+	for (size_t k=0; k < K; k++){
+	  votes[o * K + k] = (K - 1) * (log_p[k] - mean);
+	  factor[o * K + k] = exp(mean - log_p[k]);
+	  loss += m[k] * factor[o * K + k];
+	}
+      }
+      return loss;
+    };
+
+  }; // class SAMME
+
+  template <typename T>
+  constexpr double SAMME<T>::MIN_ERROR;
+  template <typename T>
+  constexpr double SAMME<T>::MIN_EDGE;
+  template <typename T>
+  constexpr double SAMME<T>::MIN_PROB;
+
+  //
+  // Multi-class strong classifier, answers the class id with the
+  // highest score
+  //
+  //  Pool is the virtual CollectionClassifiers or any pool with a
+  //  run_weak_classifier overload.
+  //
+  template <typename T,
+	    typename Pool = typename Classifier<T>::CollectionClassifiers>
+  class MultiClassStrongClassifier : public Classifier<T>
+  {
+  private:
+    MultiClassModel model_;
+    const Pool * classifiers_;
+
+    // samples scored per tile and the smallest slice of a batch
+    // worth handing to a thread (see StrongClassifier)
+    static const size_t BATCH_TILE = 256;
+    static const size_t BATCH_GRAIN = 16384;
+
+    // n x K scores for a block of at most BATCH_TILE samples,
+    // learner by learner; each answer adds one contiguous row of K
+    // votes
+    void score_block(const T * samples, size_t n, float * scores) const {
+
+      const size_t K = model_.num_classes;
+      std::fill(scores, scores + n * K, 0.0f);
+
+      int answers[BATCH_TILE];
+      for (size_t t=0; t < model_.size(); t++){
+
+	run_weak_classifier(*classifiers_, model_.learners[t], samples, n,
+			    answers);
+	const float * table = model_.table(t);
+
+	for (size_t i=0; i < n; i++){
+	  const unsigned int answer = answers[i];
+	  if (answer >= K)  // out of range answers abstain
+	    continue;
+	  const float * v = table + answer * K;
+	  float * s = scores + i * K;
+	  for (size_t k=0; k < K; k++)
+	    s[k] += v[k];
+	}
+      }
+    }
+
+    void argmax_block(const float * scores, size_t n, int * labels) const {
+
+      const size_t K = model_.num_classes;
+      for (size_t i=0; i < n; i++){
+	const float * s = scores + i * K;
+	labels[i] = std::max_element(s, s + K) - s;
+      }
+    }
+
+  public:
+    // keeps its own copy of the model
+    MultiClassStrongClassifier(const MultiClassModel & model,
+			       const Pool * cls) :
+      model_(model),
+      classifiers_(cls){};
+
+    const MultiClassModel & model() const { return model_; };
+
+    // analyze
+    //
+    int analyze(const T & feature) const {
+
+      if (model_.num_classes == 0)
+	return 0;
+
+      std::vector<float> scores(model_.num_classes);
+      score_block(&feature, 1, &scores[0]);
+      int label;
+      argmax_block(&scores[0], 1, &label);
+      return label;
+    };
+
+    // decision_function
+    //
+    //  Class scores of a contiguous batch of samples.
+    //
+    //  @param samples, n_samples samples stored back to back
+    //  @param scores, caller-provided n_samples x K buffer (row-major)
+    //  @param num_threads, # worker threads (0 = all cores)
+    void decision_function(const T * samples, size_t n_samples,
+			   float * scores,
+			   unsigned int num_threads = 0) const {
+
+      const MultiClassStrongClassifier * self = this;
+      const size_t K = model_.num_classes;
+      parallelFor(n_samples, BATCH_GRAIN, num_threads,
+		  [=](size_t begin, size_t end){
+		    for (size_t i = begin; i < end; i += BATCH_TILE){
+		      size_t n = std::min<size_t>(BATCH_TILE, end - i);
+		      self->score_block(samples + i, n, scores + i * K);
+		    }
+		  });
+    };
+
+    // predict
+    //
+    //  Class ids of a contiguous batch of samples.
+    //
+    //  @param labels, caller-provided buffer of n_samples ints
+    void predict(const T * samples, size_t n_samples,
+		 int * labels,
+		 unsigned int num_threads = 0) const {
+
+      const MultiClassStrongClassifier * self = this;
+      const size_t K = model_.num_classes;
+      parallelFor(n_samples, BATCH_GRAIN, num_threads,
+		  [=](size_t begin, size_t end){
+		    std::vector<float> scores(BATCH_TILE * K);
+		    for (size_t i = begin; i < end; i += BATCH_TILE){
+		      size_t n = std::min<size_t>(BATCH_TILE, end - i);
+		      self->score_block(samples + i, n, &scores[0]);
+		      self->argmax_block(&scores[0], n, labels + i);
+		    }
+		  });
+    };
+
+  }; // multi-class strong classifier
+
+  template <typename T, typename Pool>
+  const size_t MultiClassStrongClassifier<T, Pool>::BATCH_TILE;
+  template <typename T, typename Pool>
+  const size_t MultiClassStrongClassifier<T, Pool>::BATCH_GRAIN;
+
+} // namespace
+
+#endif
+
+
+
+
+/*************** STATIC_CLASSIFIER *******************/
+#ifndef STATIC_CLASSIFIER
+#define STATIC_CLASSIFIER 1
+
+#include <tuple>
+
+namespace DM_AG{
+
+  //
+  // A classifier whose rule is known at compile time (CRTP)
+  //
+  //  Derived provides a non-virtual  int classify(const T&) const.
+  //  ClassifierPool calls it directly, so it can be inlined and
+  //  vectorized; analyze() keeps it usable in a CollectionClassifiers.
+  //
+  template <typename Derived, typename T>
+  class StaticClassifier : public Classifier<T> {
+
+  public:
+    int analyze(const T& feature) const {
+      return static_cast<const Derived &>(*this).classify(feature);
+    };
+  };
+
+  // compile-time loops over the members of a ClassifierPool
+  template <size_t I, size_t N>
+  struct PoolLoop {
+
+    template <typename Tuple, typename Op>
+    static void each(const Tuple & learners, Op & op){
+      op(I, std::get<I>(learners));
+      PoolLoop<I + 1, N>::each(learners, op);
+    };
+
+    template <typename Tuple, typename Op>
+    static void at(const Tuple & learners, size_t c, Op & op){
+      if (c == I)
+	op(I, std::get<I>(learners));
+      else
+	PoolLoop<I + 1, N>::at(learners, c, op);
+    };
+  };
+
+  template <size_t N>
+  struct PoolLoop<N, N> {
+
+    template <typename Tuple, typename Op>
+    static void each(const Tuple &, Op &){};
+
+    template <typename Tuple, typename Op>
+    static void at(const Tuple &, size_t, Op &){};
+  };
+
+  //
+  // A compile-time pool of weak classifiers
+  //
+  //  Learners are stored by value in a tuple and called without
+  //  virtual dispatch; the virtual CollectionClassifiers stays the way
+  //  to build heterogeneous pools at run time.
+  //
+  template <typename T, typename... Learners>
+  class ClassifierPool {
+
+  private:
+    std::tuple<Learners...> learners_;
+
+    // results row c = learner c over the samples
+    struct Run {
+      const T * samples;
+      size_t n;
+      MatrixResults & results;
+
+      template <typename L>
+      void operator()(size_t c, const L & learner){
+	int * row = &results.data()[c * results.size2()];
+	for (size_t j=0; j < n; j++)
+	  row[j] = learner.classify(samples[j]);
+      };
+    };
+
+    // answers = learner c over the samples
+    struct Answer {
+      const T * samples;
+      size_t n;
+      int * answers;
+
+      template <typename L>
+      void operator()(size_t, const L & learner){
+	for (size_t j=0; j < n; j++)
+	  answers[j] = learner.classify(samples[j]);
+      };
+    };
+
+    // margins += alpha * learner c
+    struct Accumulate {
+      float alpha;
+      const T * samples;
+      size_t n;
+      float * margins;
+
+      template <typename L>
+      void operator()(size_t, const L & learner){
+	for (size_t i=0; i < n; i++)
+	  margins[i] += alpha * learner.classify(samples[i]);
+      };
+    };
+
+    // copies for the virtual path
+    struct Clone {
+      typename Classifier<T>::CollectionClassifiers & collection;
+
+      template <typename L>
+      void operator()(size_t, const L & learner){
+	collection.push_back(new L(learner));
+      };
+    };
+
+  public:
+    ClassifierPool() {};
+    explicit ClassifierPool(const Learners &... learners) :
+      learners_(learners...) {};
+
+    size_t size() const { return sizeof...(Learners); };
+
+    //
+    // Run each weak classifier over n contiguous samples
+    //
+    //  @param results, size() x n, results(c, j) = learner c on j
+    void run(const T * samples, size_t n, MatrixResults & results) const {
+      Run op = { samples, n, results };
+      PoolLoop<0, sizeof...(Learners)>::each(learners_, op);
+    };
+
+    //
+    // answers[j] = h_c(samples[j]) for n contiguous samples
+    //
+    void answer(size_t c, const T * samples, size_t n, int * answers) const {
+      Answer op = { samples, n, answers };
+      PoolLoop<0, sizeof...(Learners)>::at(learners_, c, op);
+    };
+
+    //
+    // margins[i] += alpha * h_c(samples[i]) for n contiguous samples
+    //
+    void accumulate(size_t c, float alpha, const T * samples, size_t n,
+		    float * margins) const {
+      Accumulate op = { alpha, samples, n, margins };
+      PoolLoop<0, sizeof...(Learners)>::at(learners_, c, op);
+    };
+
+    //
+    // Copies of the learners, in order, for the virtual path
+    //
+    void to_collection(typename Classifier<T>::CollectionClassifiers & collection) const {
+      Clone op = { collection };
+      PoolLoop<0, sizeof...(Learners)>::each(learners_, op);
+    };
+  };
+
+  // answers[j] = h_c(samples[j]), static pool
+  template <typename T, typename... Learners>
+  void run_weak_classifier(const ClassifierPool<T, Learners...> & pool,
+			   size_t c, const T * samples, size_t n,
+			   int * answers){
+    pool.answer(c, samples, n, answers);
+  }
+
+  // results(c, j) = h_c(samples[j]), static pool
+  template <typename T, typename... Learners>
+  void run_weak_classifiers(const ClassifierPool<T, Learners...> & pool,
+			    const T * samples, size_t n,
+			    MatrixResults & results){
+    pool.run(samples, n, results);
+  }
+
+  // margins[i] += alpha * h_c(samples[i]), static pool
+  template <typename T, typename... Learners>
+  void accumulate_votes(const ClassifierPool<T, Learners...> & pool,
+			size_t c, float alpha, const T * samples, size_t n,
+			float * margins){
+    pool.accumulate(c, alpha, samples, n, margins);
+  }
+
+} // namespace
+
+#endif
+
+
+
+/*************** ONLINE_BOOST *******************/
+#ifndef ONLINE_BOOST
+#define ONLINE_BOOST 1
+
+#include <atomic>
+#include <memory>
+#include <random>
+
+namespace DM_AG{
+
+  //
+  // Knobs of OnlineADA
+  //
+  struct OnlineBoostParameters {
+
+    // # selectors, i.e. boosting rounds of the online ensemble
+    unsigned int num_selectors;
+
+    // Oza-Russell: each selector sees a sample k ~ Poisson(lambda)
+    // times; false adds the expected count lambda instead
+    bool poisson;
+
+    // the error counts are scaled by (1 - decay) after every mini
+    // batch, so that old samples fade out (0 = never forget)
+    float decay;
+
+    // seed of the Poisson draws
+    unsigned int seed;
+
+    // bound of the importance lambda of a sample: a pick with an error
+    // near 0 multiplies it by 1/2e on a miss, so one mislabeled sample
+    // would otherwise outweigh the whole stream (and the Poisson draw)
+    float max_lambda;
+
+    OnlineBoostParameters() :
+      num_selectors(50),
+      poisson(false),
+      decay(0),
+      seed(5489u),
+      max_lambda(100) {};
+  };
+
+  //
+  // Online AdaBoost for labeled data arriving in mini batches
+  //
+  //  Oza and Russell, "Online bagging and boosting", 2001, with the
+  //  selectors of Grabner and Bischof, "On-line boosting and vision",
+  //  2006, since the weak classifiers of the pool are fixed: selector
+  //  m keeps, for every classifier c of the pool, the importance mass
+  //  lambda it got right and wrong. A sample starts with lambda = 1;
+  //  each selector picks the classifier with the lowest error so far,
+  //  and lambda grows when that pick misclassifies the sample
+  //  (lambda / 2e) and shrinks otherwise (lambda / 2(1 - e)), with e
+  //  kept in [MIN_ERROR, 1 - MIN_ERROR] and lambda in (0, max_lambda].
+  //
+  //  Memory is num_selectors x pool size counters plus the pool
+  //  answers for one mini batch, whatever the length of the stream.
+  //
+  //  update() must be called from one thread at a time. model() can
+  //  be called from any thread meanwhile: the picks and alphas of the
+  //  last mini batch are published under a sequence lock, so readers
+  //  never wait for an update and never see half of one.
+  //
+  template <typename T,
+	    typename Pool = typename Classifier<T>::CollectionClassifiers>
+  class OnlineADA {
+
+  private:
+    const Pool * classifiers_;
+    OnlineBoostParameters params_;
+    size_t classifiers_size_;
+
+    // right_[m * classifiers_size_ + c], wrong_[...], lambda masses
+    std::vector<double> right_, wrong_;
+
+    // picks of the last sample, per selector
+    std::vector<unsigned int> picks_;
+    ClassificationResults pick_alphas_;
+
+    MatrixResults results_;
+    std::vector<double> hits_, errors_;
+    std::mt19937 random_;
+    size_t samples_seen_;
+
+    // published model: even sequence = stable, odd = being written
+    std::atomic<unsigned int> sequence_;
+    std::unique_ptr<std::atomic<unsigned int>[]> published_learners_;
+    std::unique_ptr<std::atomic<float>[]> published_alphas_;
+
+    // lowest weighted error of the selectors, e in [MIN_ERROR, 0.5],
+    // and a prior mass, so that unseen classifiers sit at 0.5
+    static const double MIN_ERROR;
+    static const double MIN_MASS;
+
+    void publish(){
+
+      const unsigned int M = params_.num_selectors;
+      unsigned int s = sequence_.load(std::memory_order_relaxed);
+      sequence_.store(s + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (unsigned int m=0; m < M; m++){
+	published_learners_[m].store(picks_[m], std::memory_order_relaxed);
+	published_alphas_[m].store(pick_alphas_[m], std::memory_order_relaxed);
+      }
+      sequence_.store(s + 2, std::memory_order_release);
+    };
+
+  public:
+    OnlineADA(const Pool * cls,
+	      const OnlineBoostParameters & params = OnlineBoostParameters()) :
+      classifiers_(cls),
+      params_(params),
+      classifiers_size_(cls->size()),
+      right_(params.num_selectors * cls->size(), 0.0),
+      wrong_(params.num_selectors * cls->size(), 0.0),
+      picks_(params.num_selectors, 0),
+      pick_alphas_(params.num_selectors, 0.0f),
+      hits_(cls->size(), 0.0),
+      errors_(cls->size(), 0.0),
+      random_(params.seed),
+      samples_seen_(0),
+      sequence_(0),
+      published_learners_(new std::atomic<unsigned int>[params.num_selectors]),
+      published_alphas_(new std::atomic<float>[params.num_selectors]){
+
+      publish();
+    };
+
+    size_t samples_seen() const { return samples_seen_; };
+
+    //
+    // Learn from one mini batch
+    //
+    //  @param samples, n samples stored back to back
+    //  @param labels, their labels (e.g. -1; +1}
+    //  @param n, # samples in the batch
+    void update(const T * samples, const int * labels, size_t n){
+
+      if (n == 0 || classifiers_size_ == 0)
+	return;
+
+      // pool answers for the batch, the only per-sample memory
+      if (results_.size2() < n)
+	results_.resize(classifiers_size_, n, false);
+      run_weak_classifiers(*classifiers_, samples, n, results_);
+      const int * h = &results_.data()[0];
+      const size_t stride = results_.size2();
+
+      if (params_.decay > 0){
+	const double keep = 1.0 - params_.decay;
+	for (size_t i=0; i < right_.size(); i++){
+	  right_[i] *= keep;
+	  wrong_[i] *= keep;
+	}
+      }
+
+      std::poisson_distribution<int> draw;
+      for (size_t j=0; j < n; j++){
+
+	// which classifiers get sample j right, read once for all
+	// the selectors
+	for (size_t c=0; c < classifiers_size_; c++)
+	  hits_[c] = h[c * stride + j] == labels[j];
+
+	double lambda = 1.0;
+	for (unsigned int m=0; m < params_.num_selectors; m++){
+
+	  double k = lambda;
+	  if (params_.poisson){
+	    draw.param(std::poisson_distribution<int>::param_type(lambda));
+	    k = draw(random_);
+	  }
+
+	  // count the sample k times for every classifier (the
+	  // vectorizable pass), then pick the one with the lowest error
+	  double * right = &right_[m * classifiers_size_];
+	  double * wrong = &wrong_[m * classifiers_size_];
+	  double * errors = &errors_[0];
+	  for (size_t c=0; c < classifiers_size_; c++){
+	    right[c] += hits_[c] * k;
+	    wrong[c] += (1.0 - hits_[c]) * k;
+	    errors[c] = (wrong[c] + MIN_MASS) / (right[c] + wrong[c] + 2 * MIN_MASS);
+	  }
+	  unsigned int best = 0;
+	  for (size_t c=1; c < classifiers_size_; c++)
+	    if (errors[c] < errors[best])
+	      best = c;
+
+	  // a selector no better than chance does not vote, nor
+	  // reweights the sample
+	  if (errors[best] >= 0.5){
+	    pick_alphas_[m] = 0.0f;
+	    continue;
+	  }
+
+	  double e = std::min(std::max(errors[best], MIN_ERROR), 1.0 - MIN_ERROR);
+	  picks_[m] = best;
+	  pick_alphas_[m] = 0.5 * log((1.0 - e) / e);
+	  if (hits_[best] > 0)
+	    lambda *= 1.0 / (2.0 * (1.0 - e));
+	  else
+	    lambda *= 1.0 / (2.0 * e);
+	  lambda = std::min(lambda, (double)params_.max_lambda);
+	}
+      }
+
+      samples_seen_ += n;
+      publish();
+    };
+
+    //
+    // The ensemble of the last mini batch
+    //
+    //  Safe to call while another thread runs update(); the copy is
+    //  num_selectors values, cheap next to scoring a batch with it.
+    EnsembleModel model() const {
+
+      const unsigned int M = params_.num_selectors;
+      std::vector<unsigned int> learners(M);
+      ClassificationResults alphas(M);
+
+      unsigned int before, after;
+      do {
+	before = sequence_.load(std::memory_order_acquire);
+	for (unsigned int m=0; m < M; m++){
+	  learners[m] = published_learners_[m].load(std::memory_order_relaxed);
+	  alphas[m] = published_alphas_[m].load(std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	after = sequence_.load(std::memory_order_relaxed);
+      } while ((before & 1) || before != after);
+
+      EnsembleModel model;
+      for (unsigned int m=0; m < M; m++)
+	if (alphas[m] != 0.0f)
+	  model.add(learners[m], alphas[m]);
+      return model;
+    };
+  };
+
+  template <typename T, typename Pool>
+  const double OnlineADA<T, Pool>::MIN_ERROR = 1e-6;
+  template <typename T, typename Pool>
+  const double OnlineADA<T, Pool>::MIN_MASS = 1e-12;
+
+} // namespace
+
+#endif
+
+
+
+/*************** MODEL_FILE *******************/
+#ifndef MODEL_FILE
+#define MODEL_FILE 1
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace DM_AG{
+
+  //
+  // Ensemble model file, version 1
+  //
+  //  header                          32 bytes
+  //  uint32_t learners[num_learners] index in the classifier pool
+  //  float    alphas[num_learners]
+  //
+  //  Native byte order, checked on load through byte_order. Both
+  //  arrays are 4-byte aligned in the file, so a mapped file is used
+  //  in place: no parsing, and worker processes mapping the same file
+  //  share one physical copy.
+  //
+  struct EnsembleFileHeader {
+    char magic[4];           // "DMAE"
+    uint32_t version;
+    uint32_t byte_order;     // ENSEMBLE_BYTE_ORDER as written
+    uint32_t num_learners;
+    uint32_t pool_size;      // size of the pool the indices refer to
+    float bias;
+    uint64_t reserved;
+  };
+
+  static const char ENSEMBLE_MAGIC[4] = { 'D', 'M', 'A', 'E' };
+  static const uint32_t ENSEMBLE_VERSION = 1;
+  static const uint32_t ENSEMBLE_BYTE_ORDER = 0x01020304;
+
+  //
+  // Write a model
+  //
+  //  @param pool_size, size of the classifier pool it was trained on
+  //  @return false if the file could not be written, or the learner
+  //  count or pool size does not fit the 32-bit header fields
+  inline bool save_model(const EnsembleModel & model, size_t pool_size,
+			 const char * file_name){
+
+    if (model.size() > UINT32_MAX || pool_size > UINT32_MAX)
+      return false;
+
+    EnsembleFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ENSEMBLE_MAGIC, sizeof(header.magic));
+    header.version = ENSEMBLE_VERSION;
+    header.byte_order = ENSEMBLE_BYTE_ORDER;
+    header.num_learners = model.size();
+    header.pool_size = pool_size;
+    header.bias = model.bias;
+
+    FILE * file = fopen(file_name, "wb");
+    if (!file)
+      return false;
+    const size_t n = model.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+      (n == 0 || (fwrite(&model.learners[0], sizeof(uint32_t), n, file) == n &&
+		  fwrite(&model.alphas[0], sizeof(float), n, file) == n));
+    return fclose(file) == 0 && ok;
+  }
+
+  //
+  // A model file mapped read-only in memory
+  //
+  //  open() checks the header, the file size and the learner indices;
+  //  view() points into the mapping, which lives until close() or
+  //  destruction.
+  //
+  class MappedEnsemble {
+
+  private:
+    void * data_;
+    size_t length_;
+    EnsembleView view_;
+
+    MappedEnsemble(const MappedEnsemble &);
+    MappedEnsemble & operator=(const MappedEnsemble &);
+
+  public:
+    MappedEnsemble() : data_(NULL), length_(0) {
+      EnsembleView empty = { NULL, NULL, 0, 0 };
+      view_ = empty;
+    };
+
+    ~MappedEnsemble(){ close(); };
+
+    //
+    // Map a model file
+    //
+    //  @param pool_size, size of the pool the model will score with
+    //  (0 = do not check)
+    //  @return false if the file is missing, not a version 1 model of
+    //  this byte order, truncated, made for another pool or holding a
+    //  learner index outside the pool
+    bool open(const char * file_name, size_t pool_size = 0){
+
+      close();
+
+      int fd = ::open(file_name, O_RDONLY);
+      if (fd < 0)
+	return false;
+      struct stat st;
+      if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(EnsembleFileHeader)){
+	::close(fd);
+	return false;
+      }
+      length_ = st.st_size;
+      data_ = mmap(NULL, length_, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (data_ == MAP_FAILED){
+	data_ = NULL;
+	length_ = 0;
+	return false;
+      }
+
+      const EnsembleFileHeader * header = (const EnsembleFileHeader *)data_;
+      const size_t n = header->num_learners;
+      if (memcmp(header->magic, ENSEMBLE_MAGIC, sizeof(header->magic)) != 0 ||
+	  header->version != ENSEMBLE_VERSION ||
+	  header->byte_order != ENSEMBLE_BYTE_ORDER ||
+	  length_ != sizeof(EnsembleFileHeader) + n * (sizeof(uint32_t) + sizeof(float)) ||
+	  (pool_size && header->pool_size != pool_size)){
+	close();
+	return false;
+      }
+
+      // every index must name a classifier of the pool the file was
+      // saved for, and of the caller's pool when given, so score() never
+      // reads past the pool
+      const uint32_t * learners = (const uint32_t *)(header + 1);
+      const size_t limit = pool_size ? std::min<size_t>(pool_size, header->pool_size)
+				     : header->pool_size;
+      for (size_t t = 0; t < n; t++)
+	if (learners[t] >= limit){
+	  close();
+	  return false;
+	}
+
+      EnsembleView v = { learners, (const float *)(learners + n),
+			 header->bias, n };
+      view_ = v;
+      return true;
+    };
+
+    void close(){
+      if (data_)
+	munmap(data_, length_);
+      data_ = NULL;
+      length_ = 0;
+      EnsembleView empty = { NULL, NULL, 0, 0 };
+      view_ = empty;
+    };
+
+    const EnsembleView & view() const { return view_; };
+  };
+
+} // namespace
+
+#endif
+
+
+
+
+/*************** WEAK_CLASSIFIER *******************/
 #ifndef WEAK_CLASSIFIER 
 #define WEAK_CLASSIFIER 1
 
 namespace DM_AG{
 
-  class WeakClassifierOne : public Classifier<int>
+  class WeakClassifierOne : public StaticClassifier<WeakClassifierOne, int>
   {
   public:
-    int analyze(const int& i) const  {
+    int classify(const int& i) const  {
       
       if (i>50 && i<90) return 1;
       return -1;
     }
   };
   
-  class WeakClassifierTwo : public Classifier<int>
+  class WeakClassifierTwo : public StaticClassifier<WeakClassifierTwo, int>
   {
   public:
-    int analyze(const int& i) const {
+    int classify(const int& i) const {
       
       if (i>80 && i<130) return 1;
       return -1;
     }
   };
   
-  class WeakClassifierThree : public Classifier<int>
+  class WeakClassifierThree : public StaticClassifier<WeakClassifierThree, int>
   {
   public:
-    int analyze(const int& i) const  {
+    int classify(const int& i) const  {
       
       if (i>90 && i<130) return 1;
       return -1;
     }
   };
   
-  class WeakClassifierFour : public Classifier<int>
+  class WeakClassifierFour : public StaticClassifier<WeakClassifierFour, int>
   {
   public:
-    int analyze(const int& i) const {
+    int classify(const int& i) const {
       
       if (i>40 && i<150) return 1;
       return -1;
     }
   };
+
+  //
+  // A decision stump on one feature of a FeatureRow
+  //
+  //  +1 above the threshold, -1 otherwise. Real / Gentle AdaBoost
+  //  and LogitBoost make it confidence-rated (one value per side).
+  //
+  template <typename V>
+  class FeatureStump : public StaticClassifier<FeatureStump<V>, FeatureRow<V> > {
+
+  private:
+    size_t feature_;
+    V threshold_;
+
+  public:
+    FeatureStump(size_t feature, V threshold) :
+      feature_(feature),
+      threshold_(threshold) {};
+
+    int classify(const FeatureRow<V> & row) const {
+      return row[feature_] > threshold_ ? 1 : -1;
+    };
+  };
+
+  //
+  // Stumps at num_thresholds quantiles of each feature
+  //
+  //  @param matrix, n_rows x n_cols training values, row-major
+  //  @param classifiers, the pool the stumps are appended to
+  template <typename V>
+  void add_feature_stumps(const V * matrix, size_t n_rows, size_t n_cols,
+			  unsigned int num_thresholds,
+			  typename Classifier<FeatureRow<V> >::CollectionClassifiers & classifiers){
+
+    std::vector<V> column(n_rows);
+    for (size_t f=0; f < n_cols && n_rows > 0; f++){
+
+      for (size_t i=0; i < n_rows; i++)
+	column[i] = matrix[i * n_cols + f];
+      std::sort(column.begin(), column.end());
+
+      // a stump at the max is constant, equal quantiles are one stump
+      const V max = column.back();
+      V previous = max;
+      for (unsigned int q=1; q <= num_thresholds; q++){
+	V threshold = column[q * (n_rows - 1) / (num_thresholds + 1)];
+	if (threshold == max || threshold == previous)
+	  continue;
+	classifiers.push_back(new FeatureStump<V>(f, threshold));
+	previous = threshold;
+      }
+    }
+  }
+
+  //
+  // A multi-class stump on one feature of a FeatureRow (see SAMME)
+  //
+  //  The feature axis is cut at sorted thresholds; each interval
+  //  answers the class id most of the training samples in it have.
+  //
+  template <typename V>
+  class FeatureBins : public StaticClassifier<FeatureBins<V>, FeatureRow<V> > {
+
+  private:
+    size_t feature_;
+    std::vector<V> thresholds_;
+    std::vector<int> classes_;     // thresholds_.size() + 1
+
+  public:
+    FeatureBins(size_t feature, const std::vector<V> & thresholds,
+		const std::vector<int> & classes) :
+      feature_(feature),
+      thresholds_(thresholds),
+      classes_(classes) {};
+
+    int classify(const FeatureRow<V> & row) const {
+      return classes_[std::upper_bound(thresholds_.begin(), thresholds_.end(),
+				       row[feature_]) - thresholds_.begin()];
+    };
+  };
+
+  //
+  // Multi-class stumps with 2, 4, ..., max_bins quantile intervals on
+  // each feature
+  //
+  //  @param labels, class ids in [0, num_classes) of the rows
+  //  @param classifiers, the pool the stumps are appended to
+  template <typename V>
+  void add_feature_bins(const V * matrix, const int * labels,
+			size_t n_rows, size_t n_cols, unsigned int num_classes,
+			unsigned int max_bins,
+			typename Classifier<FeatureRow<V> >::CollectionClassifiers & classifiers){
+
+    std::vector<V> column(n_rows);
+    std::vector<size_t> counts;
+    for (size_t f=0; f < n_cols && n_rows > 0; f++){
+
+      for (size_t i=0; i < n_rows; i++)
+	column[i] = matrix[i * n_cols + f];
+      std::sort(column.begin(), column.end());
+
+      for (unsigned int bins=2; bins <= max_bins; bins *= 2){
+
+	std::vector<V> thresholds;
+	for (unsigned int q=1; q < bins; q++){
+	  V threshold = column[q * (n_rows - 1) / bins];
+	  if (thresholds.empty() || threshold > thresholds.back())
+	    thresholds.push_back(threshold);
+	}
+
+	// majority class of each interval
+	counts.assign((thresholds.size() + 1) * num_classes, 0);
+	for (size_t i=0; i < n_rows; i++){
+	  size_t b = std::upper_bound(thresholds.begin(), thresholds.end(),
+				      matrix[i * n_cols + f]) - thresholds.begin();
+	  if (labels[i] >= 0 && labels[i] < (int)num_classes)
+	    counts[b * num_classes + labels[i]]++;
+	}
+	std::vector<int> classes(thresholds.size() + 1);
+	for (size_t b=0; b < classes.size(); b++){
+	  const size_t * c = &counts[b * num_classes];
+	  classes[b] = std::max_element(c, c + num_classes) - c;
+	}
+	classifiers.push_back(new FeatureBins<V>(f, thresholds, classes));
+      }
+    }
+  }
 };
 #endif
 
@@ -270,33 +2403,694 @@ namespace DM_AG{
 
 using namespace DM_AG;
 
-uint64_t rdtsc() {
-	return __rdtsc();
+
+// One run of the training benchmark, virtual or static pool
+template <typename Pool>
+void boost_and_predict(ADA<int> & ada, const Pool & classifiers,
+		       const Classifier<int>::Data & data,
+		       const Labels & labels,
+		       std::vector<int> & predicted){
+
+  EnsembleModel model = ada.ada_boost(classifiers, data, labels, 100);
+
+  //Start the strong classifier
+
+  StrongClassifier<int, Pool> sc(model, &classifiers);
+
+  sc.predict(&data[0], data.size(), &predicted[0], 1);
+
+  sc.performance();
+}
+
+// Same, the weak classifiers already ran over the data set
+template <typename Pool>
+void boost_and_predict(ADA<int> & ada, const Pool & classifiers,
+		       const PreparedDataset & prepared,
+		       const Classifier<int>::Data & data,
+		       std::vector<int> & predicted){
+
+  EnsembleModel model = ada.ada_boost(prepared, 100);
+
+  StrongClassifier<int, Pool> sc(model, &classifiers);
+
+  sc.predict(&data[0], data.size(), &predicted[0], 1);
+
+  sc.performance();
+}
+
+// Scoring throughput of the batch predict path
+//
+//  registers predict() over batch, the training samples replicated
+//  up to the number of rows; the case keeps its own copy of sc. Each
+//  row costs a multiply-add per learner and reads and writes an int.
+template <typename Pool>
+void register_predict_benchmark(const StrongClassifier<int, Pool> & sc,
+				const std::vector<int> & batch,
+				std::vector<int> & predicted,
+				unsigned int num_threads){
+
+  std::ostringstream name;
+  name << "adaboost/predict/threads=" << getNumberOfThreads(num_threads);
+  registerBenchmark(name.str(), [sc, &batch, &predicted, num_threads](){
+      sc.predict(&batch[0], batch.size(), &predicted[0], num_threads);
+    }, batch.size(), 2.0 * batch.size() * sc.model().size(),
+    2.0 * batch.size() * sizeof(int));
+}
+
+
+// A data set of "f_1,...,f_n,label," rows
+//
+//  The features are used in place from the binary cache of the CSV
+//  file (see dataset.h), written on the first run; when it cannot be
+//  written the CSV is parsed into table.
+struct LabeledData {
+  Dataset file;
+  std::vector<double> table;
+  const double * features;     // row-major, num_features per row
+  Labels labels;               // -1 / +1
+};
+
+size_t read_labeled_csv(const char * file_name, size_t num_features,
+			LabeledData & data){
+
+  size_t num_rows, num_cols;
+  const double * values;
+  const int32_t * labels = NULL;
+  if (openDatasetCache<double>(file_name, data.file, datasetRowMajor, true)){
+    num_rows = data.file.nRows();
+    num_cols = data.file.nCols();
+    values = data.file.values<double>();
+    labels = data.file.labels();
+  }
+  else{
+    num_rows = readCsv(file_name, data.table, num_cols);
+    values = data.table.empty() ? NULL : &data.table[0];
+  }
+
+  if (labels ? num_cols != num_features : num_cols != num_features + 1)
+    return 0;
+
+  data.labels.resize(num_rows);
+  if (labels){
+    data.features = values;
+    for (size_t i = 0; i < num_rows; i++)
+      data.labels[i] = labels[i] > 0 ? 1 : -1;
+    return num_rows;
+  }
+
+  // features and labels apart
+  for (size_t i = 0; i < num_rows; i++){
+    data.labels[i] = values[i * num_cols + num_features] > 0 ? 1 : -1;
+    memmove(&data.table[i * num_features], &data.table[i * num_cols],
+	    num_features * sizeof(double));
+  }
+  data.table.resize(num_rows * num_features);
+  data.features = data.table.empty() ? NULL : &data.table[0];
+  return num_rows;
+}
+
+// Rounds and accuracy of each boosting loss on the CSV data set,
+// with 16 stumps per feature
+void loss_comparison(unsigned int num_iterations){
+
+  const size_t num_features = 20;
+  LabeledData train, test;
+  size_t n_train = read_labeled_csv("data/adaboost_data_train.csv",
+				    num_features, train);
+  size_t n_test = read_labeled_csv("data/adaboost_data_test.csv",
+				   num_features, test);
+  if (n_train == 0 || n_test == 0)
+    return;
+
+  Classifier<FeatureRow<double> >::Data rows(n_train);
+  for (size_t i = 0; i < n_train; i++){
+    rows[i].values = &train.features[i * num_features];
+    rows[i].num_features = num_features;
+  }
+
+  Classifier<FeatureRow<double> >::CollectionClassifiers stumps;
+  add_feature_stumps(&train.features[0], n_train, num_features, 16, stumps);
+
+  const char * names[] = { "discrete", "real", "gentle", "logit" };
+  ADA<FeatureRow<double> > ada;
+  std::vector<int> predicted(n_test);
+
+  for (int algorithm = DISCRETE_ADABOOST; algorithm <= LOGIT_BOOST; algorithm++){
+
+    BoostParameters params;
+    params.algorithm = (BoostAlgorithm)algorithm;
+
+    uint64_t start = tscStart();
+    EnsembleModel model = ada.ada_boost(stumps, rows, train.labels,
+					num_iterations, params);
+    uint64_t cycles = tscStop() - start;
+
+    StrongClassifier<FeatureRow<double> > sc(model, &stumps);
+    sc.predict(test.features, n_test, num_features, &predicted[0]);
+    size_t hits = 0;
+    for (size_t i = 0; i < n_test; i++)
+      hits += predicted[i] == test.labels[i];
+
+    std::cout << names[algorithm] << " rounds=" << num_iterations
+	      << " learners=" << model.size()
+	      << " test_accuracy=" << (double)hits / n_test
+	      << " cycles=" << cycles << std::endl;
+  }
+}
+
+
+// Weight trimming and early stopping against the plain rounds, for
+// each loss, on N generated rows (two Gaussian classes, 16 stumps per
+// feature, answers prepared once); a validation set of N / 4 rows
+// drives the early stopping and a test set of N / 4 rows scores the
+// models. speedup = cycles of the plain run / cycles of the run.
+void trim_comparison(size_t num_rows, unsigned int num_iterations){
+
+  typedef FeatureRow<double> Row;
+  const size_t num_features = 20;
+  const size_t sizes[] = { num_rows, num_rows / 4, num_rows / 4 };
+  if (sizes[2] == 0)
+    return;
+
+  std::vector<double> values[3];
+  Labels labels[3];
+  Classifier<Row>::Data rows[3];
+  for (int s = 0; s < 3; s++){
+    values[s].resize(sizes[s] * num_features);
+    labels[s].resize(sizes[s]);
+    generateRows(AdaBoostRows(num_features, 2.0, 1 + s), sizes[s], num_features,
+		 &values[s][0], &labels[s][0]);
+    rows[s].resize(sizes[s]);
+    for (size_t i = 0; i < sizes[s]; i++){
+      rows[s][i].values = &values[s][i * num_features];
+      rows[s][i].num_features = num_features;
+    }
+  }
+
+  Classifier<Row>::CollectionClassifiers stumps;
+  add_feature_stumps(&values[0][0], num_rows, num_features, 16, stumps);
+
+  ADA<Row> ada;
+  PreparedDataset train, validation;
+  ada.prepare(stumps, rows[0], labels[0], train);
+  ada.prepare(stumps, rows[1], labels[1], validation);
+
+  const char * names[] = { "discrete", "real", "gentle", "logit" };
+  const char * variants[] = { "plain", "trim", "early", "trim+early" };
+  std::vector<int> predicted(sizes[2]);
+  for (int algorithm = DISCRETE_ADABOOST; algorithm <= LOGIT_BOOST; algorithm++){
+
+    uint64_t plain_cycles = 0;
+    for (int v = 0; v < 4; v++){
+
+      BoostParameters params;
+      params.algorithm = (BoostAlgorithm)algorithm;
+      params.trim_fraction = (v & 1) ? 0.1f : 0.0f;
+      params.patience = (v & 2) ? 10 : 0;
+
+      uint64_t start = tscStart();
+      EnsembleModel model = params.patience ?
+	ada.ada_boost(train, num_iterations, params, validation) :
+	ada.ada_boost(train, num_iterations, params);
+      uint64_t cycles = tscStop() - start;
+      if (v == 0)
+	plain_cycles = cycles;
+
+      StrongClassifier<Row> sc(model, &stumps);
+      sc.predict(&values[2][0], sizes[2], num_features, &predicted[0]);
+      size_t hits = 0;
+      for (size_t i = 0; i < sizes[2]; i++)
+	hits += predicted[i] == labels[2][i];
+
+      std::cout << names[algorithm] << " " << variants[v]
+		<< " learners=" << model.size()
+		<< " test_accuracy=" << (double)hits / sizes[2]
+		<< " cycles=" << cycles
+		<< " speedup=" << (double)plain_cycles / cycles << std::endl;
+    }
+  }
+}
+
+
+// One-vs-rest scoring: K binary ensembles, the class of the largest
+// margin
+void one_vs_rest_predict(const std::vector<StrongClassifier<FeatureRow<double> > > & models,
+			 const double * matrix, size_t n_rows, size_t n_cols,
+			 std::vector<float> & margins, int * labels){
+
+  const size_t K = models.size();
+  margins.resize(K * n_rows);
+  for (size_t k = 0; k < K; k++)
+    models[k].decision_function(matrix, n_rows, n_cols, &margins[k * n_rows]);
+  for (size_t i = 0; i < n_rows; i++){
+    labels[i] = 0;
+    for (size_t k = 1; k < K; k++)
+      if (margins[k * n_rows + i] > margins[labels[i] * n_rows + i])
+	labels[i] = k;
+  }
+}
+
+// SAMME and SAMME.R against one-vs-rest AdaBoost on N generated rows
+// of K classes (test set N / 4): training cycles and test accuracy,
+// then the batch scoring of the test rows is registered with the
+// benchmark harness. SAMME learners are multi-class stumps
+// (add_feature_bins), one-vs-rest ones 16 stumps per feature; the
+// static pool run checks that a ClassifierPool of bins predicts as
+// its virtual copy.
+void multiclass_comparison(size_t num_rows, unsigned int num_classes,
+			   unsigned int num_iterations,
+			   const BenchmarkOptions & options){
+
+  typedef FeatureRow<double> Row;
+  const size_t num_features = 20;
+  const size_t sizes[] = { num_rows, num_rows / 4 };
+  if (num_classes < 2 || sizes[1] == 0)
+    return;
+
+  // one stream of rows (the class means come from the seed), the
+  // test rows after the training ones
+  std::vector<double> all_values((sizes[0] + sizes[1]) * num_features);
+  Labels all_labels(sizes[0] + sizes[1]);
+  generateRows(MultiClassRows(num_features, num_classes, 4.0, 1),
+	       all_labels.size(), num_features, &all_values[0], &all_labels[0]);
+
+  std::vector<double> values[2];
+  Labels labels[2];
+  Classifier<Row>::Data rows[2];
+  for (int s = 0; s < 2; s++){
+    const size_t first = s ? sizes[0] : 0;
+    values[s].assign(all_values.begin() + first * num_features,
+		     all_values.begin() + (first + sizes[s]) * num_features);
+    labels[s].assign(all_labels.begin() + first,
+		     all_labels.begin() + first + sizes[s]);
+    rows[s].resize(sizes[s]);
+    for (size_t i = 0; i < sizes[s]; i++){
+      rows[s][i].values = &values[s][i * num_features];
+      rows[s][i].num_features = num_features;
+    }
+  }
+  const Labels & test_labels = labels[1];
+  const size_t n_test = sizes[1];
+  std::vector<int> predicted(n_test);
+
+  // SAMME, SAMME.R
+  Classifier<Row>::CollectionClassifiers bins;
+  add_feature_bins(&values[0][0], &labels[0][0], num_rows, num_features,
+		   num_classes, 16, bins);
+
+  std::vector<MultiClassStrongClassifier<Row> > samme;
+  const char * names[] = { "samme", "samme.r" };
+  for (int algorithm = SAMME_DISCRETE; algorithm <= SAMME_REAL; algorithm++){
+    MultiClassModel model;
+    uint64_t start = tscStart();
+    bool ok = SAMME<Row>().samme_boost(bins, rows[0], labels[0], num_classes,
+				       num_iterations, model,
+				       (SammeAlgorithm)algorithm);
+    uint64_t cycles = tscStop() - start;
+    if (!ok){
+      std::cout << names[algorithm] << ": a label or answer is not a class id"
+		<< std::endl;
+      return;
+    }
+
+    samme.push_back(MultiClassStrongClassifier<Row>(model, &bins));
+    samme.back().predict(&rows[1][0], n_test, &predicted[0]);
+    size_t hits = 0;
+    for (size_t i = 0; i < n_test; i++)
+      hits += predicted[i] == test_labels[i];
+    std::cout << names[algorithm] << " classes=" << num_classes
+	      << " learners=" << model.size()
+	      << " test_accuracy=" << (double)hits / n_test
+	      << " cycles=" << cycles << std::endl;
+  }
+
+  // one-vs-rest
+  Classifier<Row>::CollectionClassifiers stumps;
+  add_feature_stumps(&values[0][0], num_rows, num_features, 16, stumps);
+  ADA<Row> ada;
+  Labels class_labels(num_rows);
+  std::vector<StrongClassifier<Row> > one_vs_rest;
+  size_t learners = 0;
+  uint64_t start = tscStart();
+  for (unsigned int k = 0; k < num_classes; k++){
+    for (size_t i = 0; i < num_rows; i++)
+      class_labels[i] = labels[0][i] == (int)k ? 1 : -1;
+    one_vs_rest.push_back(StrongClassifier<Row>(ada.ada_boost(stumps, rows[0], class_labels,
+							      num_iterations), &stumps));
+    learners += one_vs_rest.back().model().size();
+  }
+  uint64_t cycles = tscStop() - start;
+
+  std::vector<float> margins;
+  one_vs_rest_predict(one_vs_rest, &values[1][0], n_test, num_features,
+		      margins, &predicted[0]);
+  size_t hits = 0;
+  for (size_t i = 0; i < n_test; i++)
+    hits += predicted[i] == test_labels[i];
+  std::cout << "one_vs_rest classes=" << num_classes
+	    << " learners=" << learners
+	    << " test_accuracy=" << (double)hits / n_test
+	    << " cycles=" << cycles << std::endl;
+
+  // the 16-interval bins of the first four features, compile-time
+  typedef ClassifierPool<Row, FeatureBins<double>, FeatureBins<double>,
+			 FeatureBins<double>, FeatureBins<double> > StaticBins;
+  const size_t per_feature = bins.size() / num_features;
+  const StaticBins static_bins(static_cast<const FeatureBins<double> &>(bins[per_feature - 1]),
+			       static_cast<const FeatureBins<double> &>(bins[2 * per_feature - 1]),
+			       static_cast<const FeatureBins<double> &>(bins[3 * per_feature - 1]),
+			       static_cast<const FeatureBins<double> &>(bins[4 * per_feature - 1]));
+  Classifier<Row>::CollectionClassifiers virtual_bins;
+  static_bins.to_collection(virtual_bins);
+  MultiClassModel model;
+  SAMME<Row>().samme_boost(static_bins, rows[0], labels[0], num_classes,
+			   num_iterations, model, SAMME_REAL);
+  std::vector<int> from_virtual(n_test);
+  MultiClassStrongClassifier<Row, StaticBins>(model, &static_bins)
+    .predict(&rows[1][0], n_test, &predicted[0]);
+  MultiClassStrongClassifier<Row>(model, &virtual_bins)
+    .predict(&rows[1][0], n_test, &from_virtual[0]);
+  std::cout << "static_pool learners=" << model.size()
+	    << " same_predictions=" << (predicted == from_virtual) << std::endl;
+
+  // batch scoring of the test rows
+  const double bytes = n_test * (num_features * sizeof(double) + sizeof(int));
+  for (size_t a = 0; a < samme.size(); a++){
+    const MultiClassStrongClassifier<Row> & sc = samme[a];
+    registerBenchmark(std::string("adaboost/multiclass_predict/") + names[a], [&](){
+	sc.predict(&rows[1][0], n_test, &predicted[0]);
+      }, n_test, (double)n_test * num_classes * sc.model().size(), bytes);
+  }
+  registerBenchmark("adaboost/multiclass_predict/one_vs_rest", [&](){
+      one_vs_rest_predict(one_vs_rest, &values[1][0], n_test, num_features,
+			  margins, &predicted[0]);
+    }, n_test, 2.0 * n_test * learners, bytes);
+  runBenchmarks("adaboost", options);
+}
+
+
+// Online boosting over the CSV training rows streamed in mini batches,
+// while a second thread keeps scoring the test set with the latest model
+void online_stream(size_t batch_size, unsigned int num_passes){
+
+  const size_t num_features = 20;
+  LabeledData train, test;
+  size_t n_train = read_labeled_csv("data/adaboost_data_train.csv",
+				    num_features, train);
+  size_t n_test = read_labeled_csv("data/adaboost_data_test.csv",
+				   num_features, test);
+  if (n_train == 0 || n_test == 0 || batch_size == 0)
+    return;
+
+  typedef FeatureRow<double> Row;
+  Classifier<Row>::Data rows(n_train);
+  for (size_t i = 0; i < n_train; i++){
+    rows[i].values = &train.features[i * num_features];
+    rows[i].num_features = num_features;
+  }
+
+  Classifier<Row>::CollectionClassifiers stumps;
+  add_feature_stumps(&train.features[0], n_train, num_features, 16, stumps);
+
+  OnlineADA<Row> online(&stumps);
+  std::atomic<bool> done(false);
+  std::atomic<size_t> scored(0);
+
+  std::thread reader([&](){
+      std::vector<int> predicted(n_test);
+      while (!done.load()){
+	StrongClassifier<Row> sc(online.model(), &stumps);
+	sc.predict(test.features, n_test, num_features, &predicted[0], 1);
+	scored += n_test;
+      }
+    });
+
+  uint64_t start = tscStart();
+  for (unsigned int pass = 0; pass < num_passes; pass++)
+    for (size_t i = 0; i < n_train; i += batch_size)
+      online.update(&rows[i], &train.labels[i],
+		    std::min(batch_size, n_train - i));
+  uint64_t cycles = tscStop() - start;
+
+  done = true;
+  reader.join();
+
+  StrongClassifier<Row> sc(online.model(), &stumps);
+  std::vector<int> predicted(n_test);
+  sc.predict(test.features, n_test, num_features, &predicted[0]);
+  size_t hits = 0;
+  for (size_t i = 0; i < n_test; i++)
+    hits += predicted[i] == test.labels[i];
+
+  std::cout << "online samples=" << online.samples_seen()
+	    << " learners=" << sc.model().size()
+	    << " test_accuracy=" << (double)hits / n_test
+	    << " cycles/sample=" << (double)cycles / online.samples_seen()
+	    << " rows_scored_meanwhile=" << scored.load() << std::endl;
+}
+
+
+// Trains on the CSV data set, writes the model, maps it back and
+// checks that the mapped model predicts the same labels
+void model_file(const char * file_name){
+
+  const size_t num_features = 20;
+  LabeledData train, test;
+  size_t n_train = read_labeled_csv("data/adaboost_data_train.csv",
+				    num_features, train);
+  size_t n_test = read_labeled_csv("data/adaboost_data_test.csv",
+				   num_features, test);
+  if (n_train == 0 || n_test == 0)
+    return;
+
+  typedef FeatureRow<double> Row;
+  Classifier<Row>::Data rows(n_train);
+  for (size_t i = 0; i < n_train; i++){
+    rows[i].values = &train.features[i * num_features];
+    rows[i].num_features = num_features;
+  }
+
+  Classifier<Row>::CollectionClassifiers stumps;
+  add_feature_stumps(&train.features[0], n_train, num_features, 16, stumps);
+
+  BoostParameters params;
+  params.algorithm = REAL_ADABOOST;
+  ADA<Row> ada;
+  EnsembleModel model = ada.ada_boost(stumps, rows, train.labels, 100, params);
+  if (!save_model(model, stumps.size(), file_name)){
+    std::cout << "cannot write " << file_name << std::endl;
+    return;
+  }
+
+  uint64_t start = tscStart();
+  MappedEnsemble mapped;
+  bool ok = mapped.open(file_name, stumps.size());
+  uint64_t cycles = tscStop() - start;
+  if (!ok){
+    std::cout << "cannot map " << file_name << std::endl;
+    return;
+  }
+
+  std::vector<int> trained(n_test), loaded(n_test);
+  StrongClassifier<Row>(model, &stumps).predict(test.features, n_test, num_features,
+						&trained[0]);
+  StrongClassifier<Row>(mapped.view(), &stumps).predict(test.features, n_test,
+							num_features, &loaded[0]);
+
+  // the same learners saved for a pool of one classifier hold indices
+  // outside it, open() must refuse the file even without a pool size
+  uint32_t largest = 0;
+  for (size_t t = 0; t < model.learners.size(); t++)
+    largest = std::max(largest, model.learners[t]);
+  const std::string corrupt_name = std::string(file_name) + ".bad";
+  MappedEnsemble corrupt;
+  bool rejected = largest == 0 || (save_model(model, 1, corrupt_name.c_str()) &&
+				   !corrupt.open(corrupt_name.c_str()));
+  remove(corrupt_name.c_str());
+
+  std::cout << "model learners=" << mapped.view().size()
+	    << " map_cycles=" << cycles
+	    << " same_predictions=" << (trained == loaded)
+	    << " rejects_bad_index=" << rejected << std::endl;
+}
+
+
+// A synthetic data set of one precision for the sweep, with its
+// stumps (16 per feature) and their prepared answers; remade when N
+// or D change
+template <typename V>
+struct SweepData {
+  size_t n, d;
+  std::vector<V> values;
+  Labels labels;
+  typename Classifier<FeatureRow<V> >::Data rows;
+  typename Classifier<FeatureRow<V> >::CollectionClassifiers stumps;
+  PreparedDataset prepared;
+  std::vector<int> predicted;
+
+  SweepData() : n(0), d(0) {};
+
+  void make(size_t num_rows, size_t num_features){
+    if (num_rows == n && num_features == d)
+      return;
+    n = num_rows;
+    d = num_features;
+    values.resize(n * d);
+    labels.resize(n);
+    generateRows(AdaBoostRows(d, 2.0, 1), n, d, &values[0], &labels[0]);
+
+    rows.resize(n);
+    for (size_t i = 0; i < n; i++){
+      rows[i].values = &values[i * d];
+      rows[i].num_features = d;
+    }
+    stumps.clear();
+    add_feature_stumps(&values[0], n, d, 16, stumps);
+    ADA<FeatureRow<V> >().prepare(stumps, rows, labels, prepared);
+    predicted.resize(n);
+  }
+};
+
+// The run of one sweep point, K = boosting rounds
+//
+//  virtual   weak classifiers and rounds (one thread)
+//  prepared  rounds over the prepared answers (one thread)
+//  predict   batch scoring of the N rows with the model of K rounds
+template <typename V>
+bool sweep_case(SweepData<V> & data, const SweepPoint & p, BenchmarkCase & c){
+
+  if (p.variant != "predict" && p.threads != 1)
+    return false;
+  data.make(p.n, p.d);
+
+  SweepData<V> * s = &data;
+  const unsigned int rounds = p.k;
+  if (p.variant == "virtual")
+    c.run = [s, rounds](){
+      EnsembleModel model = ADA<FeatureRow<V> >().ada_boost(s->stumps, s->rows,
+							     s->labels, rounds);
+      benchmarkKeep(model.bias);
+    };
+  else if (p.variant == "prepared")
+    c.run = [s, rounds](){
+      EnsembleModel model = ADA<FeatureRow<V> >().ada_boost(s->prepared, rounds);
+      benchmarkKeep(model.bias);
+    };
+  else if (p.variant == "predict"){
+    StrongClassifier<FeatureRow<V> >
+      sc(ADA<FeatureRow<V> >().ada_boost(s->prepared, rounds), &s->stumps);
+    const unsigned int threads = p.threads;
+    c.run = [s, sc, threads](){
+      sc.predict(&s->values[0], s->n, s->d, &s->predicted[0], threads);
+    };
+    c.flopsPerRun = 2.0 * p.n * sc.model().size();
+    c.bytesPerRun = p.n * (p.d * sizeof(V) + sizeof(int));
+  }
+  else
+    return false;
+  return true;
+}
+
+// adaboost sweep [--n LIST] [--d LIST] [--k ROUNDS] [--threads LIST]
+//                [--precision double,float]
+//                [--variant virtual,prepared,predict] [--weak] [--out FILE]
+//
+//  two Gaussian classes from datagen.h (see sweep.h for the lists)
+int adaboost_sweep(int argc, char *argv[], const BenchmarkOptions & options){
+
+  SweepOptions sweep;
+  sweep.n.push_back(2000);
+  sweep.d.push_back(20);
+  sweep.k.push_back(100);
+  sweep.precisions.push_back("double");
+  sweep.precisions.push_back("float");
+  sweep.variants.push_back("virtual");
+  sweep.variants.push_back("prepared");
+  sweep.variants.push_back("predict");
+  parseSweepOptions(argc, argv, sweep);
+
+  SweepData<double> data_double;
+  SweepData<float> data_float;
+  runSweep("adaboost", sweep, options,
+	   [&](const SweepPoint & p, BenchmarkCase & c) -> bool {
+	     if (p.precision == "double")
+	       return sweep_case(data_double, p, c);
+	     if (p.precision == "float")
+	       return sweep_case(data_float, p, c);
+	     return false;
+	   });
+  return 0;
 }
 
 
 /*************** MAIN *******************/
-int main(){
+//
+//  adaboost                          training benchmark (cycles per run)
+//  adaboost predict [rows] [threads] batch scoring throughput
+//  adaboost static ...               same, with the compile-time pool
+//  adaboost [static] prepared ...    same, weak classifiers run once
+//  adaboost losses [rounds]          discrete / real / gentle / logit
+//  adaboost trim [rows] [rounds]     trimming, early stopping vs plain
+//  adaboost multiclass [rows] [classes] [rounds]
+//                                    SAMME / SAMME.R vs one-vs-rest
+//  adaboost online [batch] [passes]  streaming updates, concurrent predict
+//  adaboost model [file]             save, map and check a model file
+//  adaboost sweep [options]          scaling table (adaboost_sweep)
+//
+//  the benchmarks take the benchmark.h options anywhere on the line:
+//  --warmup N, --samples N, --min-time S, --filter TEXT, --json FILE
+int main(int argc, char *argv[]){
+
+  // --warmup, --samples, --min-time, --filter, --json (benchmark.h)
+  BenchmarkOptions options;
+  parseBenchmarkOptions(argc, argv, options);
+
+  if (argc > 1 && strcmp(argv[1], "sweep") == 0)
+    return adaboost_sweep(argc, argv, options);
+
+  if (argc > 1 && strcmp(argv[1], "model") == 0){
+    model_file(argc > 2 ? argv[2] : "adaboost.model");
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "online") == 0){
+    online_stream(argc > 2 ? strtoul(argv[2], NULL, 10) : 256,
+		  argc > 3 ? atoi(argv[3]) : 1);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "losses") == 0){
+    loss_comparison(argc > 2 ? atoi(argv[2]) : 100);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "multiclass") == 0){
+    multiclass_comparison(argc > 2 ? strtoul(argv[2], NULL, 10) : 10000,
+			  argc > 3 ? atoi(argv[3]) : 5,
+			  argc > 4 ? atoi(argv[4]) : 100, options);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "trim") == 0){
+    trim_comparison(argc > 2 ? strtoul(argv[2], NULL, 10) : 10000,
+		    argc > 3 ? atoi(argv[3]) : 100);
+    return 0;
+  }
 
   Classifier<int>::Data data;
   Labels labels;
-  std::ifstream file("data/adaboost_data_train.csv");
-  std::string value;
-  double value2;
+  std::vector<double> table;
+  size_t num_cols;
+  readCsv("data/adaboost_data_train.csv", table, num_cols);
  
-  uint64_t uiInicio, uiFim;
-  int iTam = 1000;
-
   const unsigned int number_features = 20;
 
   // SIMULATE A TRAINER
 
   //std::cout << "Training ... " << std::endl;
 
-  for (unsigned int i=0; i < number_features; i++){	  
-  	getline(file, value, ',');
-  	value2 = stod(value);
-    data.push_back(value2);
+  for (unsigned int i=0; i < number_features && i < table.size(); i++){
+    data.push_back(table[i]);
     // ground-truth classifier (TRAINER)
       
     (i>7&&i<13) ? 
@@ -314,31 +3108,76 @@ int main(){
   classifiers.push_back(new WeakClassifierThree());
   classifiers.push_back(new WeakClassifierFour());
 
+  typedef ClassifierPool<int, WeakClassifierOne, WeakClassifierTwo,
+			 WeakClassifierThree, WeakClassifierFour> StaticPool;
+  StaticPool static_classifiers;
+
+  int arg = 1;
+  const bool use_static = argc > arg && strcmp(argv[arg], "static") == 0;
+  if (use_static)
+    arg++;
+
+  // run the weak classifiers once for all the boosting runs
+  const bool use_prepared = argc > arg && strcmp(argv[arg], "prepared") == 0;
+  if (use_prepared)
+    arg++;
+  PreparedDataset prepared;
+
   //
   // Ada boosting
   //
   ADA<int> ada;
   //std::cout << "Boosting ... " << std::endl;
 
-  uiInicio = rdtsc();
-  for (int i = 0; i < iTam; i++) {
-    ClassificationResults weights = ada.ada_boost(classifiers, data, labels, 100);
+  std::vector<int> predicted(data.size());
 
-    unsigned int classifiers_size = classifiers.size();
-     
-    //Start the strong classifier
-    
-    StrongClassifier<int> sc(weights, &classifiers, labels);
-
-    for (unsigned int i=0; i < number_features; i++){
-      sc.analyze(i);
-    }
-
-    sc.performance();
+  if (use_prepared && use_static){
+    registerBenchmark("adaboost/prepare_static", [&](){
+	ada.prepare(static_classifiers, data, labels, prepared);
+      }, data.size());
+    ada.prepare(static_classifiers, data, labels, prepared);
+    registerBenchmark("adaboost/train_static_prepared", [&](){
+	boost_and_predict(ada, static_classifiers, prepared, data, predicted);
+      });
   }
-  uiFim = rdtsc();
-  
-  std::cout << (uiFim - uiInicio) / iTam;
+  else if (use_prepared){
+    registerBenchmark("adaboost/prepare", [&](){
+	ada.prepare(classifiers, data, labels, prepared);
+      }, data.size());
+    ada.prepare(classifiers, data, labels, prepared);
+    registerBenchmark("adaboost/train_prepared", [&](){
+	boost_and_predict(ada, classifiers, prepared, data, predicted);
+      });
+  }
+  else if (use_static)
+    registerBenchmark("adaboost/train_static", [&](){
+	boost_and_predict(ada, static_classifiers, data, labels, predicted);
+      });
+  else
+    registerBenchmark("adaboost/train", [&](){
+	boost_and_predict(ada, classifiers, data, labels, predicted);
+      });
+
+  std::vector<int> batch, batch_predicted;
+  if (argc > arg && strcmp(argv[arg], "predict") == 0){
+    size_t num_rows = argc > arg + 1 ? strtoul(argv[arg + 1], NULL, 10) : 10000000;
+    unsigned int num_threads = argc > arg + 2 ? atoi(argv[arg + 2]) : 0;
+
+    batch.resize(num_rows);
+    for (size_t i = 0; i < num_rows; i++)
+      batch[i] = data[i % data.size()];
+    batch_predicted.resize(num_rows);
+
+    EnsembleModel model = ada.ada_boost(classifiers, data, labels, 100);
+    if (use_static)
+      register_predict_benchmark(StrongClassifier<int, StaticPool>(model, &static_classifiers),
+				 batch, batch_predicted, num_threads);
+    else
+      register_predict_benchmark(StrongClassifier<int>(model, &classifiers),
+				 batch, batch_predicted, num_threads);
+  }
+
+  runBenchmarks("adaboost", options);
  
   return 0;
 }
@@ -1,5 +1,8 @@
 #include "daal.h"
 #include "service.h"
+#include "benchmark.h"
+#include "datagen.h"
+#include "sweep.h"
 
 //#include <intrin.h>
 #include <stdint.h>
@@ -17,19 +20,130 @@ const size_t nFeatures = 20;
 
 services::SharedPtr<adaboost::training::Result> trainingResult;
 services::SharedPtr<classifier::prediction::Result> predictionResult;
+NumericTablePtr testData;
 NumericTablePtr testGroundTruth;
 
 void trainModel();
+void loadTestData();
 void testModel();
 void printResults();
 
-uint64_t rdtsc() {
-	return __rdtsc();
+/* A synthetic data set of one precision for the sweep, remade when N or
+ * D change, and the model of the last training run */
+template <typename T>
+struct SweepData
+{
+    size_t n, d;
+    vector<T> values, labels;
+    NumericTablePtr data, groundTruth;
+    services::SharedPtr<adaboost::training::Result> model;
+
+    SweepData() : n(0), d(0) {}
+
+    void make(size_t nRows, size_t nCols)
+    {
+        if (nRows == n && nCols == d)
+        {
+            return;
+        }
+        n = nRows;
+        d = nCols;
+        values.resize(n * d);
+        vector<int> y(n);
+        generateRows(AdaBoostRows(d, 2.0, 1), n, d, &values[0], &y[0]);
+        labels.assign(y.begin(), y.end());
+        data        = NumericTablePtr(new HomogenNumericTable<T>(&values[0], d, n));
+        groundTruth = NumericTablePtr(new HomogenNumericTable<T>(&labels[0], 1, n));
+        model = services::SharedPtr<adaboost::training::Result>();
+    }
+
+    void train(size_t rounds)
+    {
+        adaboost::training::Batch<T> algorithm;
+        algorithm.parameter.maxIterations = rounds;
+        algorithm.input.set(classifier::training::data, data);
+        algorithm.input.set(classifier::training::labels, groundTruth);
+        algorithm.compute();
+        model = algorithm.getResult();
+    }
+
+    void predict()
+    {
+        adaboost::prediction::Batch<T> algorithm;
+        algorithm.input.set(classifier::prediction::data, data);
+        algorithm.input.set(classifier::prediction::model, model->get(classifier::training::model));
+        algorithm.compute();
+    }
+};
+
+/* daal trains K rounds, daal_predict scores the N rows with that model */
+template <typename T>
+bool sweepCase(SweepData<T> &data, const SweepPoint &p, BenchmarkCase &c)
+{
+    data.make(p.n, p.d);
+    SweepData<T> *s     = &data;
+    const size_t rounds = p.k;
+    if (p.variant == "daal")
+    {
+        c.run = [s, rounds]() { s->train(rounds); };
+    }
+    else if (p.variant == "daal_predict")
+    {
+        s->train(rounds);
+        c.run = [s]() { s->predict(); };
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/* adaboost_daal sweep [sweep.h options]
+ *
+ * The rows of "adaboost sweep" for DAAL: the same two Gaussian classes
+ * (datagen.h), K = rounds, DAAL limited to the threads of each point. */
+int adaboostSweep(int argc, char *argv[], const BenchmarkOptions &options)
+{
+    SweepOptions sweep;
+    sweep.n.push_back(2000);
+    sweep.d.push_back(nFeatures);
+    sweep.k.push_back(100);
+    sweep.precisions.push_back("double");
+    sweep.precisions.push_back("float");
+    sweep.variants.push_back("daal");
+    sweep.variants.push_back("daal_predict");
+    parseSweepOptions(argc, argv, sweep);
+
+    SweepData<double> dataDouble;
+    SweepData<float> dataFloat;
+    runSweep("adaboost", sweep, options, [&](const SweepPoint &p, BenchmarkCase &c) -> bool {
+        services::Environment::getInstance()->setNumberOfThreads(p.threads);
+        if (p.precision == "double")
+        {
+            return sweepCase(dataDouble, p, c);
+        }
+        if (p.precision == "float")
+        {
+            return sweepCase(dataFloat, p, c);
+        }
+        return false;
+    });
+    return 0;
 }
 
 
 int main(int argc, char *argv[])
 {
+    /* --warmup, --samples, --min-time, --filter, --json (benchmark.h) */
+    BenchmarkOptions options;
+    parseBenchmarkOptions(argc, argv, options);
+
+    if (argc > 1 && strcmp(argv[1], "sweep") == 0)
+    {
+        return adaboostSweep(argc, argv, options);
+    }
+
     checkArguments(argc, argv, 2, &trainDatasetFileName, &testDatasetFileName);
 
     /* Initialize FileDataSource<CSVFeatureManager> to retrieve the input data from a .csv file */
@@ -52,32 +166,27 @@ int main(int argc, char *argv[])
     algorithm.input.set(classifier::training::data, trainData);
     algorithm.input.set(classifier::training::labels, trainGroundTruth);    
 	
-    //Inicio da medicao de tempo
-    uint64_t uiInicio, uiFim;
-    int iTam = 1000;
-
-	uiInicio = rdtsc();
-	for (int i = 0; i < iTam; i++) {
+    registerBenchmark("adaboost_daal/train", [&]() {
         /* Train the AdaBoost model */
         algorithm.compute();
 
         /* Retrieve the results of the training algorithm  */
         trainingResult = algorithm.getResult();
-	}
-	uiFim = rdtsc();
-
-    testModel();
-    //printResults();
+    }, trainData->getNumberOfRows());
 
-	//Fim da medicao de tempo
-	
+    /* scores the test set with the model of the last training run */
+    algorithm.compute();
+    trainingResult = algorithm.getResult();
+    loadTestData();
+    registerBenchmark("adaboost_daal/predict", testModel, testData->getNumberOfRows());
 
-	cout << (uiFim - uiInicio)/iTam;
+    runBenchmarks("adaboost_daal", options);
+    //printResults();
 
     return 0;
 }
 
-void testModel()
+void loadTestData()
 {
     /* Initialize FileDataSource<CSVFeatureManager> to retrieve the test data from a .csv file */
     FileDataSource<CSVFeatureManager> testDataSource(testDatasetFileName,
@@ -85,13 +194,16 @@ void testModel()
                                                      DataSource::doDictionaryFromContext);
 
     /* Create Numeric Tables for testing data and labels */
-    NumericTablePtr testData(new HomogenNumericTable<double>(nFeatures, 0, NumericTable::notAllocate));
+    testData = NumericTablePtr(new HomogenNumericTable<double>(nFeatures, 0, NumericTable::notAllocate));
     testGroundTruth = NumericTablePtr(new HomogenNumericTable<double>(1, 0, NumericTable::notAllocate));
     NumericTablePtr mergedData(new MergedNumericTable(testData, testGroundTruth));
 
     /* Retrieve the data from input file */
     testDataSource.loadDataBlock(mergedData.get());
+}
 
+void testModel()
+{
     /* Create algorithm objects for AdaBoost prediction with the default method */
     adaboost::prediction::Batch<> algorithm;
 
@@ -0,0 +1,776 @@
+/* file: benchmark.h */
+/*
+!  Content:
+!    Benchmark harness shared by the examples: named cases, warmup runs,
+!    per-run samples of serialized TSC cycles and wall time, robust
+!    statistics, optional hardware counters, text and JSON reports
+!******************************************************************************/
+
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <cpuid.h>
+    #include <x86intrin.h>
+    #define BENCHMARK_HAS_TSC 1
+#else
+    #define BENCHMARK_HAS_TSC 0
+#endif
+
+#if defined(__linux__)
+    #include <errno.h>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #define BENCHMARK_HAS_PERF 1
+#else
+    #define BENCHMARK_HAS_PERF 0
+#endif
+
+/* Steady clock in nanoseconds */
+inline uint64_t steadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Opening TSC read: the lfences keep earlier instructions from sinking
+ * below it and the measured code from starting before it */
+inline uint64_t tscStart()
+{
+#if BENCHMARK_HAS_TSC
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+#else
+    return steadyNanoseconds();
+#endif
+}
+
+/* Closing TSC read: rdtscp waits for the measured code to complete and
+ * the lfence keeps later instructions from starting before it */
+inline uint64_t tscStop()
+{
+#if BENCHMARK_HAS_TSC
+    unsigned int aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+#else
+    return steadyNanoseconds();
+#endif
+}
+
+/* TSC ticks per second, calibrated against the steady clock on the first
+ * call (about 30 ms) */
+inline double calibrateTscFrequency()
+{
+#if BENCHMARK_HAS_TSC
+    double best = 0;
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        uint64_t ns0 = steadyNanoseconds();
+        uint64_t c0  = tscStart();
+        uint64_t ns1;
+        do
+        {
+            ns1 = steadyNanoseconds();
+        } while (ns1 - ns0 < 10000000);
+        uint64_t c1 = tscStop();
+        double hz   = (double)(c1 - c0) * 1e9 / (double)(ns1 - ns0);
+        /* the lowest estimate had the fewest interruptions between reads */
+        best = (attempt == 0 || hz < best) ? hz : best;
+    }
+    return best;
+#else
+    return 1e9;
+#endif
+}
+
+inline double tscFrequency()
+{
+    static const double hz = calibrateTscFrequency();
+    return hz;
+}
+
+inline double tscToSeconds(double cycles)
+{
+    return cycles / tscFrequency();
+}
+
+/* Keeps the compiler from dropping a result that is otherwise unused */
+template <typename T>
+inline void benchmarkKeep(const T &value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const T *volatile sink;
+    sink = &value;
+#endif
+}
+
+/* Hardware events counted with --perf. The floating point events are
+ * FP_ARITH_INST_RETIRED of Intel Broadwell and later, opened on Intel
+ * processors only; FMA instructions count twice there. */
+enum PerfCounter
+{
+    perfCycles,
+    perfInstructions,
+    perfL1dMisses,
+    perfLlcMisses,
+    perfBranchMisses,
+    perfFpScalarDouble,
+    perfFpScalarSingle,
+    perfFp128Double,
+    perfFp128Single,
+    perfFp256Double,
+    perfFp256Single,
+    perfFp512Double,
+    perfFp512Single,
+    perfCounterCount
+};
+
+static const char *const perfCounterNames[perfCounterCount] = {
+    "cycles",        "instructions",  "l1d_misses",    "llc_misses",    "branch_misses", "fp_scalar_double", "fp_scalar_single",
+    "fp_128_double", "fp_128_single", "fp_256_double", "fp_256_single", "fp_512_double", "fp_512_single"
+};
+
+/* floating point operations per instruction of each FP event */
+static const double perfFlopsPerEvent[perfCounterCount] = { 0, 0, 0, 0, 0, 1, 1, 2, 4, 4, 8, 8, 16 };
+
+inline bool isIntelProcessor()
+{
+#if BENCHMARK_HAS_TSC
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(0, &eax, &ebx, &ecx, &edx) && ebx == 0x756e6547 && edx == 0x49656e69 && ecx == 0x6c65746e; /* GenuineIntel */
+#else
+    return false;
+#endif
+}
+
+/* Counters of the calling thread and of the threads it starts while
+ * counting (parallelFor workers), user space only. Events the kernel or
+ * the processor does not provide - no PMU in a virtual machine,
+ * perf_event_paranoid, not Linux - are simply not counted and read as -1. */
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+        for (int i = 0; i < perfCounterCount; i++)
+        {
+            _fd[i] = -1;
+        }
+    }
+
+    ~PerfCounters() { close(); }
+
+    /* true if at least one event could be opened, otherwise error() says why */
+    bool open()
+    {
+        close();
+#if BENCHMARK_HAS_PERF
+        const uint64_t cacheMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        openEvent(perfCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        openEvent(perfInstructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        openEvent(perfL1dMisses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheMiss);
+        openEvent(perfLlcMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        openEvent(perfBranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        if (isIntelProcessor())
+        {
+            /* event 0xC7, umask 0x01 (scalar double) to 0x80 (512-bit single) */
+            for (int i = perfFpScalarDouble; i <= perfFp512Single; i++)
+            {
+                openEvent((PerfCounter)i, PERF_TYPE_RAW, 0xC7 | (0x100 << (i - perfFpScalarDouble)));
+            }
+        }
+        for (int i = 0; i < perfCounterCount; i++)
+        {
+            if (_fd[i] >= 0)
+            {
+                return true;
+            }
+        }
+#else
+        _error = "perf_event_open needs Linux";
+#endif
+        return false;
+    }
+
+    void close()
+    {
+        for (int i = 0; i < perfCounterCount; i++)
+        {
+            if (_fd[i] >= 0)
+            {
+                ::close(_fd[i]);
+                _fd[i] = -1;
+            }
+        }
+    }
+
+    void start()
+    {
+#if BENCHMARK_HAS_PERF
+        for (int i = 0; i < perfCounterCount; i++)
+        {
+            if (_fd[i] >= 0)
+            {
+                ioctl(_fd[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /* continues counting after stop(), without a reset */
+    void resume()
+    {
+#if BENCHMARK_HAS_PERF
+        for (int i = 0; i < perfCounterCount; i++)
+        {
+            if (_fd[i] >= 0)
+            {
+                ioctl(_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void stop()
+    {
+#if BENCHMARK_HAS_PERF
+        for (int i = 0; i < perfCounterCount; i++)
+        {
+            if (_fd[i] >= 0)
+            {
+                ioctl(_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /* count since start(), scaled up when the kernel multiplexed the
+     * event with others; -1 if the event was not counted */
+    double value(PerfCounter c) const
+    {
+        uint64_t v[3]; /* value, time enabled, time running */
+        if (_fd[c] < 0 || read(_fd[c], v, sizeof(v)) != (ssize_t)sizeof(v) || v[2] == 0)
+        {
+            return -1;
+        }
+        return v[2] < v[1] ? (double)v[0] * v[1] / v[2] : (double)v[0];
+    }
+
+    const std::string &error() const { return _error; }
+
+private:
+    PerfCounters(const PerfCounters &);
+    PerfCounters &operator=(const PerfCounters &);
+
+#if BENCHMARK_HAS_PERF
+    void openEvent(PerfCounter c, uint32_t type, uint64_t config)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = type;
+        attr.config         = config;
+        attr.disabled       = 1;
+        attr.inherit        = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        _fd[c] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (_fd[c] < 0 && _error.empty())
+        {
+            _error = std::string("perf_event_open: ") + strerror(errno);
+        }
+    }
+#endif
+
+    int _fd[perfCounterCount];
+    std::string _error;
+};
+
+struct BenchmarkOptions
+{
+    unsigned int warmup;     /* untimed runs before sampling */
+    unsigned int minSamples; /* samples taken at least ... */
+    unsigned int maxSamples; /* ... and at most */
+    double minSeconds;       /* sampling stops once this much was measured */
+    std::string filter;      /* runs the cases whose name contains it */
+    std::string jsonFile;    /* JSON report, "-" for stdout, empty for none */
+    bool text;               /* one line per case on stdout */
+    bool perf;               /* hardware counters (PerfCounters) */
+
+    BenchmarkOptions() : warmup(3), minSamples(10), maxSamples(1000), minSeconds(1.0), text(true), perf(false) {}
+};
+
+/* Removes the harness options from argv so that the drivers parse their
+ * own positional arguments as before:
+ *   --warmup N     untimed runs per case (default 3)
+ *   --samples N    exactly N samples per case
+ *   --min-time S   sample for at least S seconds (default 1), between 10
+ *                  and 1000 samples
+ *   --filter TEXT  only the cases whose name contains TEXT
+ *   --json FILE    JSON report, - for stdout (the text report is then
+ *                  left out)
+ *   --perf         hardware counters over the timed samples */
+inline void parseBenchmarkOptions(int &argc, char *argv[], BenchmarkOptions &options)
+{
+    int kept = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (hasValue && strcmp(argv[i], "--warmup") == 0)
+        {
+            options.warmup = atoi(argv[++i]);
+        }
+        else if (hasValue && strcmp(argv[i], "--samples") == 0)
+        {
+            options.minSamples = options.maxSamples = std::max(1, atoi(argv[++i]));
+            options.minSeconds = 0;
+        }
+        else if (hasValue && strcmp(argv[i], "--min-time") == 0)
+        {
+            options.minSeconds = atof(argv[++i]);
+        }
+        else if (hasValue && strcmp(argv[i], "--filter") == 0)
+        {
+            options.filter = argv[++i];
+        }
+        else if (hasValue && strcmp(argv[i], "--json") == 0)
+        {
+            options.jsonFile = argv[++i];
+            options.text     = options.jsonFile != "-";
+        }
+        else if (strcmp(argv[i], "--perf") == 0)
+        {
+            options.perf = true;
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc       = kept;
+    argv[argc] = NULL;
+}
+
+struct SampleStats
+{
+    double min, max, mean, median, p95, p99, stddev;
+};
+
+/* p in [0, 1], linear between the closest ranks */
+inline double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    double rank = p * (sorted.size() - 1);
+    size_t low  = (size_t)rank;
+    size_t high = std::min(low + 1, sorted.size() - 1);
+    return sorted[low] + (rank - low) * (sorted[high] - sorted[low]);
+}
+
+inline SampleStats computeStats(std::vector<double> values)
+{
+    SampleStats s;
+    memset(&s, 0, sizeof(s));
+    if (values.empty())
+    {
+        return s;
+    }
+    std::sort(values.begin(), values.end());
+
+    double sum = 0;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        sum += values[i];
+    }
+    s.mean = sum / values.size();
+
+    double squares = 0;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        squares += (values[i] - s.mean) * (values[i] - s.mean);
+    }
+    s.stddev = values.size() > 1 ? sqrt(squares / (values.size() - 1)) : 0;
+
+    s.min    = values.front();
+    s.max    = values.back();
+    s.median = percentile(values, 0.5);
+    s.p95    = percentile(values, 0.95);
+    s.p99    = percentile(values, 0.99);
+    return s;
+}
+
+/* A named piece of work; run() is one iteration, itemsPerRun the rows,
+ * points or matrices it processes (for the items/s figure). flopsPerRun
+ * and bytesPerRun, when known, are the floating point operations and the
+ * bytes of data the algorithm has to touch per run, counted from its
+ * loops rather than measured; they give GFLOP/s and GB/s. setup(), when
+ * set, runs untimed before every run() to give it the same starting
+ * state, e.g. for a step that changes what it works on. */
+struct BenchmarkCase
+{
+    std::string name;
+    std::function<void()> run;
+    std::function<void()> setup;
+    double itemsPerRun;
+    double flopsPerRun;
+    double bytesPerRun;
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    size_t samples;     /* timed samples */
+    size_t batch;       /* runs per sample, > 1 for runs below the timer resolution */
+    double itemsPerRun;
+    double flopsPerRun;
+    double bytesPerRun;
+    SampleStats cycles; /* TSC ticks per run */
+    SampleStats seconds; /* wall time per run */
+    bool hasCounters;
+    double counters[perfCounterCount]; /* per run, -1 when not counted */
+
+    double counter(PerfCounter c) const { return hasCounters ? counters[c] : -1; }
+
+    double ipc() const
+    {
+        return counter(perfCycles) > 0 && counter(perfInstructions) >= 0 ? counters[perfInstructions] / counters[perfCycles] : -1;
+    }
+
+    /* floating point operations per run from the FP events, -1 if not counted */
+    double measuredFlops() const
+    {
+        double flops = -1;
+        for (int i = perfFpScalarDouble; i <= perfFp512Single; i++)
+        {
+            if (counter((PerfCounter)i) >= 0)
+            {
+                flops = std::max(flops, 0.0) + counters[i] * perfFlopsPerEvent[i];
+            }
+        }
+        return flops;
+    }
+};
+
+/* Warns once that the counters are unavailable */
+inline PerfCounters *openPerfCounters(PerfCounters &counters)
+{
+    static bool warned = false;
+    if (counters.open())
+    {
+        return &counters;
+    }
+    if (!warned)
+    {
+        fprintf(stderr, "hardware counters unavailable (%s), timing only\n", counters.error().c_str());
+        warned = true;
+    }
+    return NULL;
+}
+
+/* Samples shorter than this run the case several times */
+const double benchmarkMinSampleSeconds = 20e-6;
+
+inline BenchmarkResult runBenchmark(const BenchmarkCase &c, const BenchmarkOptions &options)
+{
+    for (unsigned int i = 0; i < options.warmup; i++)
+    {
+        if (c.setup)
+        {
+            c.setup();
+        }
+        c.run();
+    }
+
+    /* batch size from one timed run; one run per sample with a setup */
+    size_t batch = 1;
+    if (!c.setup)
+    {
+        uint64_t t0 = steadyNanoseconds();
+        c.run();
+        double once = (steadyNanoseconds() - t0) * 1e-9;
+        batch       = once < benchmarkMinSampleSeconds ? (size_t)(benchmarkMinSampleSeconds / std::max(once, 1e-9)) + 1 : 1;
+    }
+
+    PerfCounters counters;
+    PerfCounters *perf = options.perf ? openPerfCounters(counters) : NULL;
+    if (perf)
+    {
+        perf->start();
+    }
+
+    std::vector<double> cycles, seconds;
+    double measured = 0;
+    while (cycles.size() < options.maxSamples && (cycles.size() < options.minSamples || measured < options.minSeconds))
+    {
+        if (c.setup)
+        {
+            if (perf)
+            {
+                perf->stop();
+            }
+            c.setup();
+            if (perf)
+            {
+                perf->resume();
+            }
+        }
+        uint64_t ns = steadyNanoseconds();
+        uint64_t c0 = tscStart();
+        for (size_t b = 0; b < batch; b++)
+        {
+            c.run();
+        }
+        uint64_t c1    = tscStop();
+        double elapsed = (steadyNanoseconds() - ns) * 1e-9;
+
+        cycles.push_back((double)(c1 - c0) / batch);
+        seconds.push_back(elapsed / batch);
+        measured += elapsed;
+    }
+
+    BenchmarkResult r;
+    r.name        = c.name;
+    r.samples     = cycles.size();
+    r.batch       = batch;
+    r.itemsPerRun = c.itemsPerRun;
+    r.flopsPerRun = c.flopsPerRun;
+    r.bytesPerRun = c.bytesPerRun;
+    r.cycles      = computeStats(cycles);
+    r.seconds     = computeStats(seconds);
+    r.hasCounters = perf != NULL;
+    if (perf)
+    {
+        perf->stop();
+        const double runs = (double)r.samples * batch;
+        for (int i = 0; i < perfCounterCount; i++)
+        {
+            double v      = perf->value((PerfCounter)i);
+            r.counters[i] = v < 0 ? -1 : v / runs;
+        }
+    }
+    return r;
+}
+
+inline std::vector<BenchmarkCase> &benchmarkRegistry()
+{
+    static std::vector<BenchmarkCase> cases;
+    return cases;
+}
+
+inline void registerBenchmark(const std::string &name, const std::function<void()> &run, double itemsPerRun = 1, double flopsPerRun = 0,
+                              double bytesPerRun = 0)
+{
+    BenchmarkCase c;
+    c.name        = name;
+    c.run         = run;
+    c.itemsPerRun = itemsPerRun;
+    c.flopsPerRun = flopsPerRun;
+    c.bytesPerRun = bytesPerRun;
+    benchmarkRegistry().push_back(c);
+}
+
+inline void printBenchmarkResult(const BenchmarkResult &r)
+{
+    printf("%s: samples=%zu median=%.0f cycles (%.6g s) p95=%.0f p99=%.0f stddev=%.0f", r.name.c_str(), r.samples, r.cycles.median,
+           r.seconds.median, r.cycles.p95, r.cycles.p99, r.cycles.stddev);
+    if (r.itemsPerRun > 1 && r.seconds.median > 0)
+    {
+        printf(" items/s=%.4g", r.itemsPerRun / r.seconds.median);
+    }
+    if (r.flopsPerRun > 0 && r.seconds.median > 0)
+    {
+        printf(" GFLOP/s=%.4g", r.flopsPerRun / r.seconds.median * 1e-9);
+    }
+    if (r.bytesPerRun > 0 && r.seconds.median > 0)
+    {
+        printf(" bytes/run=%.4g GB/s=%.4g", r.bytesPerRun, r.bytesPerRun / r.seconds.median * 1e-9);
+    }
+    printf("\n");
+    if (r.hasCounters)
+    {
+        /* per run */
+        printf("  ");
+        if (r.ipc() >= 0)
+        {
+            printf(" IPC=%.3g", r.ipc());
+        }
+        for (int i = 0; i < perfFpScalarDouble; i++)
+        {
+            if (r.counters[i] >= 0)
+            {
+                printf(" %s=%.4g", perfCounterNames[i], r.counters[i]);
+            }
+        }
+        if (r.counter(perfLlcMisses) >= 0)
+        {
+            printf(" llc_bytes=%.4g", r.counters[perfLlcMisses] * 64);
+        }
+        if (r.measuredFlops() >= 0 && r.seconds.median > 0)
+        {
+            printf(" flops=%.4g measured_GFLOP/s=%.4g", r.measuredFlops(), r.measuredFlops() / r.seconds.median * 1e-9);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+inline std::string jsonString(const std::string &s)
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\')
+        {
+            out += '\\';
+        }
+        if ((unsigned char)s[i] >= 0x20)
+        {
+            out += s[i];
+        }
+    }
+    return out + "\"";
+}
+
+inline void writeJsonStats(FILE *f, const char *name, const SampleStats &s)
+{
+    fprintf(f, "\"%s\": {\"min\": %.9g, \"median\": %.9g, \"mean\": %.9g, \"p95\": %.9g, \"p99\": %.9g, \"max\": %.9g, \"stddev\": %.9g}", name, s.min,
+            s.median, s.mean, s.p95, s.p99, s.max, s.stddev);
+}
+
+/* "program", "host", "date", "hardware_threads" and "tsc_hz" members */
+inline void writeJsonContext(FILE *f, const char *program)
+{
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    char date[32] = "";
+    time_t now    = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(f, "\"program\": %s, \"host\": %s, \"date\": \"%s\", \"hardware_threads\": %u, \"tsc_hz\": %.6g", jsonString(program).c_str(),
+            jsonString(host).c_str(), date, std::thread::hardware_concurrency(), tscFrequency());
+}
+
+/* {"context": {...}, "benchmarks": [{"name": ..., "cycles": {...}, "seconds": {...},
+ *  "derived": {...}, "counters": {...}}, ...]} */
+inline bool writeBenchmarkJson(const char *fileName, const char *program, const BenchmarkOptions &options,
+                               const std::vector<BenchmarkResult> &results)
+{
+    FILE *f = strcmp(fileName, "-") == 0 ? stdout : fopen(fileName, "w");
+    if (!f)
+    {
+        return false;
+    }
+
+    fprintf(f, "{\n  \"context\": {");
+    writeJsonContext(f, program);
+    fprintf(f, ", \"warmup\": %u, \"min_samples\": %u, \"max_samples\": %u, \"min_seconds\": %g, \"perf\": %s},\n  \"benchmarks\": [",
+            options.warmup, options.minSamples, options.maxSamples, options.minSeconds, options.perf ? "true" : "false");
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &r = results[i];
+        fprintf(f, "%s\n    {\"name\": %s, \"samples\": %zu, \"batch\": %zu, \"items_per_run\": %.9g, ", i ? "," : "", jsonString(r.name).c_str(),
+                r.samples, r.batch, r.itemsPerRun);
+        writeJsonStats(f, "cycles", r.cycles);
+        fprintf(f, ", ");
+        writeJsonStats(f, "seconds", r.seconds);
+        if (r.seconds.median > 0)
+        {
+            fprintf(f, ", \"derived\": {\"items_per_second\": %.9g", r.itemsPerRun / r.seconds.median);
+            if (r.flopsPerRun > 0)
+            {
+                fprintf(f, ", \"flops_per_run\": %.9g, \"gflops\": %.9g", r.flopsPerRun, r.flopsPerRun / r.seconds.median * 1e-9);
+            }
+            if (r.bytesPerRun > 0)
+            {
+                fprintf(f, ", \"bytes_per_run\": %.9g, \"gbytes_per_second\": %.9g", r.bytesPerRun, r.bytesPerRun / r.seconds.median * 1e-9);
+            }
+            if (r.ipc() >= 0)
+            {
+                fprintf(f, ", \"ipc\": %.6g", r.ipc());
+            }
+            if (r.counter(perfLlcMisses) >= 0)
+            {
+                fprintf(f, ", \"llc_bytes_per_run\": %.9g", r.counters[perfLlcMisses] * 64);
+            }
+            if (r.measuredFlops() >= 0)
+            {
+                fprintf(f, ", \"measured_flops_per_run\": %.9g, \"measured_gflops\": %.9g", r.measuredFlops(),
+                        r.measuredFlops() / r.seconds.median * 1e-9);
+            }
+            fprintf(f, "}");
+        }
+        if (r.hasCounters)
+        {
+            /* per run, events that could not be counted left out */
+            fprintf(f, ", \"counters\": {");
+            const char *separator = "";
+            for (int i = 0; i < perfCounterCount; i++)
+            {
+                if (r.counters[i] >= 0)
+                {
+                    fprintf(f, "%s\"%s\": %.9g", separator, perfCounterNames[i], r.counters[i]);
+                    separator = ", ";
+                }
+            }
+            fprintf(f, "}");
+        }
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return f == stdout ? fflush(f) == 0 : fclose(f) == 0;
+}
+
+/* Runs the registered cases that match the filter, prints them and writes
+ * the JSON report. Returns the results in registration order. */
+inline std::vector<BenchmarkResult> runBenchmarks(const char *program, const BenchmarkOptions &options)
+{
+    std::vector<BenchmarkResult> results;
+    const std::vector<BenchmarkCase> &cases = benchmarkRegistry();
+    for (size_t i = 0; i < cases.size(); i++)
+    {
+        if (options.filter.empty() || cases[i].name.find(options.filter) != std::string::npos)
+        {
+            results.push_back(runBenchmark(cases[i], options));
+            if (options.text)
+            {
+                printBenchmarkResult(results.back());
+            }
+        }
+    }
+
+    if (!options.jsonFile.empty() && !writeBenchmarkJson(options.jsonFile.c_str(), program, options, results))
+    {
+        fprintf(stderr, "Unable to write file '%s'\n", options.jsonFile.c_str());
+    }
+    return results;
+}
+
+#endif
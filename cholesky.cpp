@@ -0,0 +1,531 @@
+// cholesky.cpp : the hand-written Cholesky decomposition of cholesky.h,
+// in double and float, on the matrix that cholesky_daal.cpp factors
+//
+//  cholesky [threads] [file] [block size]
+//  cholesky sweep [sweep.h options]
+//  cholesky batch [n] [count] [threads]
+//  cholesky solve [n] [nrhs] [threads]
+//
+//  threads     default all cores
+//  file        a symmetric positive definite matrix, one row per line
+//              (datagen cholesky <n>), default data/cholesky_data.csv
+//  block size  panel width, default from the L2 size
+//
+// Times the blocked (choleskyFactorize) and tiled (choleskyFactorizeTiled)
+// engines, and the blocked one on the lower and upper triangles packed by
+// rows (choleskyFactorizePacked). Each run factors a fresh copy of the
+// matrix (benchmark.h setup), the factors are then checked:
+// max |A - L * L^T| / max |A| over up to 256 rows must stay below
+// 100 * n * epsilon.
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchmark.h"
+#include "cholesky.h"
+#include "datagen.h"
+#include "dataset.h"
+#include "sweep.h"
+
+using namespace std;
+
+// max |A - L * L^T| / max |A| over up to 256 evenly spaced rows, lower
+// triangle
+template <typename T>
+double choleskyResidual(const double * a, const T * l, size_t n)
+{
+	double norm = 0, error = 0;
+	const size_t step = max<size_t>(1, n / 256);
+	for (size_t i = 0; i < n; i += step)
+	{
+		for (size_t j = 0; j <= i; j++)
+		{
+			double sum = 0;
+			for (size_t p = 0; p <= j; p++)
+				sum += (double)l[i * n + p] * l[j * n + p];
+			norm = max(norm, fabs(a[i * n + j]));
+			error = max(error, fabs(a[i * n + j] - sum));
+		}
+	}
+	return norm > 0 ? error / norm : error;
+}
+
+const char * variants[] = { "blocked", "tiled", "packed_lower", "packed_upper" };
+const int nVariants = 4;
+
+bool is_packed(const string & variant)
+{
+	return variant == "packed_lower" || variant == "packed_upper";
+}
+
+CholeskyTriangle triangle_of(const string & variant)
+{
+	return variant == "packed_upper" ? choleskyUpper : choleskyLower;
+}
+
+// the engines of cholesky.h by name, a full n x n or packed as the variant
+template <typename T>
+size_t factorize(const string & variant, T * a, size_t n, unsigned int nThreads, size_t block)
+{
+	if (variant == "tiled")
+		return choleskyFactorizeTiled(a, n, n, nThreads, block);
+	if (is_packed(variant))
+		return choleskyFactorizePacked(a, n, triangle_of(variant), nThreads, block);
+	return choleskyFactorize(a, n, n, nThreads, block);
+}
+
+// the full n x n a in the storage of the variant
+template <typename T>
+void store(const string & variant, const vector<double> & a, size_t n, vector<T> & out)
+{
+	if (!is_packed(variant))
+	{
+		out.assign(a.begin(), a.end());
+		return;
+	}
+	out.resize(n * (n + 1) / 2);
+	choleskyPackTriangle(&a[0], n, n, triangle_of(variant), &out[0]);
+}
+
+template <typename T>
+bool checkFactor(const string & variant, const char * precision, const vector<double> & a, const vector<T> & input, size_t n,
+	unsigned int nThreads, size_t block)
+{
+	const string name = "cholesky/" + variant + "/" + precision;
+	vector<T> l(input);
+	size_t info = factorize(variant, &l[0], n, nThreads, block);
+	if (info)
+	{
+		cout << name << ": the leading minor of order " << info << " is not positive definite" << endl;
+		return false;
+	}
+	if (is_packed(variant))
+	{
+		// back to a full L, U^T for the upper triangle
+		vector<T> full(n * n);
+		choleskyUnpackTriangle(&l[0], n, triangle_of(variant), &full[0], n);
+		if (triangle_of(variant) == choleskyUpper)
+			for (size_t i = 0; i < n; i++)
+				for (size_t j = 0; j < i; j++)
+					swap(full[i * n + j], full[j * n + i]);
+		l.swap(full);
+	}
+	const double residual = choleskyResidual(&a[0], &l[0], n);
+	const double tolerance = 100.0 * n * numeric_limits<T>::epsilon();
+	printf("%s: residual=%.3g (tolerance %.3g) %s\n", name.c_str(), residual, tolerance, residual <= tolerance ? "ok" : "FAILED");
+	return residual <= tolerance;
+}
+
+// The CholeskyRows matrix (datagen.h) of order n in the storage of the
+// variant, made row by row so that a packed one never takes n x n
+void generate(const string & variant, size_t n, vector<double> & a)
+{
+	const bool packed = is_packed(variant);
+	const CholeskyTriangle triangle = triangle_of(variant);
+	if (!packed)
+	{
+		a.resize(n * n);
+		generateRows(CholeskyRows(n, 1), n, n, &a[0], (int *)NULL);
+		return;
+	}
+	a.resize(n * (n + 1) / 2);
+	CholeskyPackedLowerRows<double> lower(&a[0]);
+	CholeskyPackedUpperRows<double> upper(&a[0], n);
+	parallelFor(n, 64, 0, [&](size_t begin, size_t end) {
+		vector<double> row(n);
+		for (size_t i = begin; i < end; i++)
+		{
+			CholeskyRows(n, 1)(i, &row[0], (int *)NULL);
+			if (triangle == choleskyLower)
+				copy(row.begin(), row.begin() + i + 1, lower(i));
+			else
+				copy(row.begin() + i, row.end(), upper(i) + i);
+		}
+	});
+}
+
+// cholesky sweep [--n LIST] [--d LIST] [--threads LIST]
+//                [--precision double,float]
+//                [--variant blocked,tiled,packed_lower,packed_upper]
+//                [--out FILE]
+//
+//  Strong scaling of the engines on CholeskyRows matrices (datagen.h),
+//  made once per n and storage. D is the block or tile size, 0 (the
+//  default) for choleskyBlockSize. --weak is refused: the work grows as
+//  n^3, so rows per thread do not keep it constant.
+int cholesky_sweep(int argc, char *argv[], const BenchmarkOptions & options)
+{
+	SweepOptions sweep;
+	sweep.n.push_back(2000);
+	sweep.d.push_back(0);
+	sweep.k.push_back(0);
+	sweep.precisions.push_back("double");
+	sweep.precisions.push_back("float");
+	sweep.variants.push_back("blocked");
+	sweep.variants.push_back("tiled");
+	parseSweepOptions(argc, argv, sweep);
+	if (sweep.weak)
+	{
+		cout << "cholesky sweep: strong scaling only" << endl;
+		return 1;
+	}
+
+	// the matrix of the last point
+	size_t data_n = 0;
+	bool data_packed = false;
+	CholeskyTriangle data_triangle = choleskyLower;
+	vector<double> a, work;
+	vector<float> af, work_float;
+
+	runSweep("cholesky", sweep, options, [&](const SweepPoint & p, BenchmarkCase & c) -> bool {
+		if (find(variants, variants + nVariants, p.variant) == variants + nVariants || (p.precision != "double" && p.precision != "float") ||
+			p.n == 0)
+			return false;
+
+		const bool packed = is_packed(p.variant);
+		if (p.n != data_n || packed != data_packed || (packed && triangle_of(p.variant) != data_triangle))
+		{
+			data_n = p.n;
+			data_packed = packed;
+			data_triangle = triangle_of(p.variant);
+			generate(p.variant, p.n, a);
+			af.assign(a.begin(), a.end());
+		}
+
+		const string variant = p.variant;
+		const size_t n = p.n, block = p.d;
+		const unsigned int threads = p.threads;
+		if (p.precision == "double")
+		{
+			c.setup = [&]() { work = a; };
+			c.run = [&work, variant, n, threads, block]() { factorize(variant, &work[0], n, threads, block); };
+		}
+		else
+		{
+			c.setup = [&]() { work_float = af; };
+			c.run = [&work_float, variant, n, threads, block]() { factorize(variant, &work_float[0], n, threads, block); };
+		}
+
+		const double N = n;
+		c.itemsPerRun = 1;
+		c.flopsPerRun = N * N * N / 3;
+		c.bytesPerRun = N * (N + 1) * (p.precision == "double" ? sizeof(double) : sizeof(float));
+		return true;
+	});
+	return 0;
+}
+
+// cholesky batch [n] [count] [threads]
+//
+//  count generated matrices of order n (CholeskyRows of datagen.h, seeds
+//  1 to count), default 100000 of order 8: choleskyFactorizeBatch
+//  against a choleskyFactorize call per matrix, in double and float,
+//  then the largest difference between the two factors.
+template <typename T>
+void register_batch(const char * precision, const vector<double> & matrices, vector<T> & input, vector<T> & work,
+	size_t n, size_t count, unsigned int nThreads)
+{
+	input.assign(matrices.begin(), matrices.end());
+	const double N = n;
+	BenchmarkCase c;
+	c.itemsPerRun = count;
+	c.flopsPerRun = count * N * N * N / 3;
+	c.bytesPerRun = count * N * (N + 1) * sizeof(T);
+	c.setup = [&]() { work = input; };
+
+	c.name = string("cholesky/batch/") + precision;
+	c.run = [&work, n, count, nThreads]() { choleskyFactorizeBatch(&work[0], count, n, (size_t *)NULL, nThreads); };
+	benchmarkRegistry().push_back(c);
+
+	c.name = string("cholesky/batch_loop/") + precision;
+	c.run = [&work, n, count]() {
+		for (size_t m = 0; m < count; m++)
+			choleskyFactorize(&work[m * n * n], n, n, 1);
+	};
+	benchmarkRegistry().push_back(c);
+}
+
+template <typename T>
+bool check_batch(const char * precision, const vector<T> & input, size_t n, size_t count, unsigned int nThreads)
+{
+	vector<T> batch(input), loop(input);
+	size_t failed = choleskyFactorizeBatch(&batch[0], count, n, (size_t *)NULL, nThreads);
+	double difference = 0, norm = 0;
+	for (size_t m = 0; m < count; m++)
+		failed += choleskyFactorize(&loop[m * n * n], n, n, 1) != 0;
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		difference = max(difference, fabs((double)batch[i] - loop[i]));
+		norm = max(norm, fabs((double)loop[i]));
+	}
+	const double relative = norm > 0 ? difference / norm : difference;
+	const bool ok = failed == 0 && relative <= 100 * numeric_limits<T>::epsilon();
+	printf("cholesky/batch/%s: %zu failed, max |L_batch - L| / max |L| = %.3g %s\n", precision, failed, relative, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int cholesky_batch(int argc, char *argv[], const BenchmarkOptions & options)
+{
+	const size_t n = argc > 2 ? strtoull(argv[2], NULL, 10) : 8;
+	const size_t count = argc > 3 ? strtoull(argv[3], NULL, 10) : 100000;
+	const unsigned int nThreads = argc > 4 ? atoi(argv[4]) : 0;
+	if (n == 0 || count == 0)
+	{
+		cout << "usage: cholesky batch [n] [count] [threads]" << endl;
+		return 1;
+	}
+
+	vector<double> matrices(count * n * n);
+	parallelFor(count, 256, nThreads, [&](size_t begin, size_t end) {
+		for (size_t m = begin; m < end; m++)
+		{
+			CholeskyRows make(n, m + 1);
+			for (size_t i = 0; i < n; i++)
+				make(i, &matrices[(m * n + i) * n], (int *)NULL);
+		}
+	});
+
+	vector<double> input, work;
+	vector<float> input_float, work_float;
+	register_batch("double", matrices, input, work, n, count, nThreads);
+	register_batch("float", matrices, input_float, work_float, n, count, nThreads);
+	runBenchmarks("cholesky batch", options);
+
+	bool ok = check_batch("double", input, n, count, nThreads);
+	ok = check_batch("float", input_float, n, count, nThreads) && ok;
+	return ok ? 0 : 1;
+}
+
+// cholesky solve [n] [nrhs] [threads]
+//
+//  On the CholeskyRows matrix A of order n (default 2000) and its factor
+//  L: choleskySolve of nrhs (default 16) random right-hand sides and the
+//  rank-1 choleskyUpdate and choleskyDowndate, each against the
+//  choleskyFactorize it saves, in double and float. Then checked:
+//  max |A * X - B| / (max |A| * max |X|), the update against the factor
+//  of A + x * x^T, and its downdate against L.
+template <typename T>
+struct SolveData
+{
+	vector<T> a, l, updated, b, x;
+	vector<T> work;
+};
+
+template <typename T>
+void register_solve(const char * precision, const vector<double> & a, size_t n, size_t nrhs, unsigned int nThreads, SolveData<T> & d)
+{
+	d.a.assign(a.begin(), a.end());
+	d.l = d.a;
+	choleskyFactorize(&d.l[0], n, n, nThreads);
+	d.b.resize(n * nrhs);
+	d.x.resize(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		RowRandom random(2, i);
+		for (size_t j = 0; j < nrhs; j++)
+			d.b[i * nrhs + j] = (T)(2.0 * random.uniform() - 1.0);
+		d.x[i] = (T)(2.0 * random.uniform() - 1.0);
+	}
+	d.updated = d.l;
+	choleskyUpdate(&d.updated[0], n, n, &d.x[0], nThreads);
+
+	const double N = n;
+	const string prefix = string("cholesky/");
+	BenchmarkCase c;
+	c.itemsPerRun = 1;
+
+	c.name = prefix + "refactorize/" + precision;
+	c.flopsPerRun = N * N * N / 3;
+	c.bytesPerRun = N * (N + 1) * sizeof(T);
+	c.setup = [&d]() { d.work = d.a; };
+	c.run = [&d, n, nThreads]() { choleskyFactorize(&d.work[0], n, n, nThreads); };
+	benchmarkRegistry().push_back(c);
+
+	// two triangular solves, L read twice
+	c.name = prefix + "solve/" + precision;
+	c.itemsPerRun = nrhs;
+	c.flopsPerRun = 2 * N * N * nrhs;
+	c.bytesPerRun = (N * (N + 1) + 4 * N * nrhs) * sizeof(T);
+	c.setup = [&d]() { d.work = d.b; };
+	c.run = [&d, n, nrhs, nThreads]() { choleskySolve(&d.l[0], n, n, &d.work[0], nrhs, nrhs, nThreads); };
+	benchmarkRegistry().push_back(c);
+
+	// a rotation is 6 flops per element of the lower triangle
+	c.itemsPerRun = 1;
+	c.flopsPerRun = 3 * N * N;
+	c.bytesPerRun = N * (N + 1) * sizeof(T);
+	c.name = prefix + "update/" + precision;
+	c.setup = [&d]() { d.work = d.l; };
+	c.run = [&d, n, nThreads]() { choleskyUpdate(&d.work[0], n, n, &d.x[0], nThreads); };
+	benchmarkRegistry().push_back(c);
+
+	c.name = prefix + "downdate/" + precision;
+	c.setup = [&d]() { d.work = d.updated; };
+	c.run = [&d, n, nThreads]() { choleskyDowndate(&d.work[0], n, n, &d.x[0], nThreads); };
+	benchmarkRegistry().push_back(c);
+}
+
+// max |x - y| / max |y|
+template <typename T>
+double relative_difference(const vector<T> & x, const vector<T> & y)
+{
+	double difference = 0, norm = 0;
+	for (size_t i = 0; i < x.size(); i++)
+	{
+		difference = max(difference, fabs((double)x[i] - y[i]));
+		norm = max(norm, fabs((double)y[i]));
+	}
+	return norm > 0 ? difference / norm : difference;
+}
+
+template <typename T>
+bool check_solve(const char * precision, size_t n, size_t nrhs, unsigned int nThreads, const SolveData<T> & d)
+{
+	const double tolerance = 100.0 * n * numeric_limits<T>::epsilon();
+	bool ok = true;
+
+	vector<T> x(d.b);
+	choleskySolve(&d.l[0], n, n, &x[0], nrhs, nrhs, nThreads);
+	double error = 0, normA = 0, normX = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		for (size_t j = 0; j < nrhs; j++)
+		{
+			double sum = 0;
+			for (size_t p = 0; p < n; p++)
+				sum += (double)d.a[i * n + p] * x[p * nrhs + j];
+			error = max(error, fabs(sum - d.b[i * nrhs + j]));
+			normX = max(normX, fabs((double)x[i * nrhs + j]));
+		}
+		for (size_t p = 0; p < n; p++)
+			normA = max(normA, fabs((double)d.a[i * n + p]));
+	}
+	const double residual = error / (normA * normX);
+	printf("cholesky/solve/%s: residual=%.3g (tolerance %.3g) %s\n", precision, residual, tolerance, residual <= tolerance ? "ok" : "FAILED");
+	ok = residual <= tolerance && ok;
+
+	// A + x * x^T factored from scratch
+	vector<T> plus(d.a);
+	for (size_t i = 0; i < n; i++)
+		for (size_t j = 0; j < n; j++)
+			plus[i * n + j] += d.x[i] * d.x[j];
+	size_t info = choleskyFactorize(&plus[0], n, n, nThreads);
+	const double update = relative_difference(d.updated, plus);
+	printf("cholesky/update/%s: max |L_update - L| / max |L| = %.3g %s\n", precision, update, !info && update <= tolerance ? "ok" : "FAILED");
+	ok = !info && update <= tolerance && ok;
+
+	vector<T> down(d.updated);
+	info = choleskyDowndate(&down[0], n, n, &d.x[0], nThreads);
+	const double downdate = relative_difference(down, d.l);
+	printf("cholesky/downdate/%s: max |L_downdate - L| / max |L| = %.3g %s\n", precision, downdate,
+		!info && downdate <= tolerance ? "ok" : "FAILED");
+	return !info && downdate <= tolerance && ok;
+}
+
+int cholesky_solve(int argc, char *argv[], const BenchmarkOptions & options)
+{
+	const size_t n = argc > 2 ? strtoull(argv[2], NULL, 10) : 2000;
+	const size_t nrhs = argc > 3 ? strtoull(argv[3], NULL, 10) : 16;
+	const unsigned int nThreads = argc > 4 ? atoi(argv[4]) : 0;
+	if (n == 0 || nrhs == 0)
+	{
+		cout << "usage: cholesky solve [n] [nrhs] [threads]" << endl;
+		return 1;
+	}
+
+	vector<double> a(n * n);
+	generateRows(CholeskyRows(n, 1), n, n, &a[0], (int *)NULL, nThreads);
+	SolveData<double> data;
+	SolveData<float> data_float;
+	register_solve("double", a, n, nrhs, nThreads, data);
+	register_solve("float", a, n, nrhs, nThreads, data_float);
+	runBenchmarks("cholesky solve", options);
+
+	bool ok = check_solve("double", n, nrhs, nThreads, data);
+	ok = check_solve("float", n, nrhs, nThreads, data_float) && ok;
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	// --warmup, --samples, --min-time, --filter, --json (benchmark.h)
+	BenchmarkOptions options;
+	parseBenchmarkOptions(argc, argv, options);
+
+	if (argc > 1 && strcmp(argv[1], "sweep") == 0)
+		return cholesky_sweep(argc, argv, options);
+	if (argc > 1 && strcmp(argv[1], "batch") == 0)
+		return cholesky_batch(argc, argv, options);
+	if (argc > 1 && strcmp(argv[1], "solve") == 0)
+		return cholesky_solve(argc, argv, options);
+
+	unsigned int nThreads = argc > 1 ? atoi(argv[1]) : 0;
+	const char * fileName = argc > 2 ? argv[2] : "data/cholesky_data.csv";
+	size_t block = argc > 3 ? strtoull(argv[3], NULL, 10) : 0;
+
+	// mapped from the binary cache (written on the first run) or parsed
+	Dataset dataset;
+	vector<double> a;
+	size_t n, nCols;
+	if (openDatasetCache<double>(fileName, dataset, datasetRowMajor, false, nThreads))
+	{
+		n = dataset.nRows();
+		nCols = dataset.nCols();
+		a.assign(dataset.values<double>(), dataset.values<double>() + n * nCols);
+	}
+	else
+		n = readCsv(fileName, a, nCols, nThreads);
+	if (n == 0 || n != nCols)
+	{
+		cout << "Unable to read a square matrix from '" << fileName << "'" << endl;
+		return 1;
+	}
+	vector<float> af(a.begin(), a.end());
+
+	// n^3 / 3 flops, the lower triangle read and written in place
+	vector<vector<double> > inputs(nVariants);
+	vector<vector<float> > inputs_float(nVariants);
+	vector<double> work;
+	vector<float> work_float;
+	const double N = n;
+	for (int v = 0; v < nVariants; v++)
+	{
+		const string variant = variants[v];
+		store(variant, a, n, inputs[v]);
+		store(variant, a, n, inputs_float[v]);
+		const vector<double> & input = inputs[v];
+		const vector<float> & input_float = inputs_float[v];
+
+		BenchmarkCase c;
+		c.itemsPerRun = 1;
+		c.flopsPerRun = N * N * N / 3;
+		c.bytesPerRun = N * (N + 1) * sizeof(double);
+		c.name = "cholesky/" + variant + "/double";
+		c.setup = [&]() { work = input; };
+		c.run = [&, variant]() { factorize(variant, &work[0], n, nThreads, block); };
+		benchmarkRegistry().push_back(c);
+
+		c.bytesPerRun = N * (N + 1) * sizeof(float);
+		c.name = "cholesky/" + variant + "/float";
+		c.setup = [&]() { work_float = input_float; };
+		c.run = [&, variant]() { factorize(variant, &work_float[0], n, nThreads, block); };
+		benchmarkRegistry().push_back(c);
+	}
+
+	runBenchmarks("cholesky", options);
+
+	bool ok = true;
+	for (int v = 0; v < nVariants; v++)
+	{
+		ok = checkFactor(variants[v], "double", a, inputs[v], n, nThreads, block) && ok;
+		ok = checkFactor(variants[v], "float", a, inputs_float[v], n, nThreads, block) && ok;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,1176 @@
+/* file: cholesky.h */
+/*
+!  Content:
+!    Hand-written Cholesky decomposition, the native counterpart of
+!    cholesky::Batch<> in cholesky_daal.cpp
+!******************************************************************************/
+
+#ifndef _CHOLESKY_H
+#define _CHOLESKY_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <unistd.h>
+#if defined(__AVX__)
+    #include <immintrin.h>
+#endif
+
+#include "parallel.h"
+
+/* Register block of the trailing update: CholeskyKernel<T>::run adds
+ * up an mr x nr block of C = A * B^T from kc columns of both, A packed
+ * by mr rows and B by nr rows, p-major (a[p * mr + r], b[p * nr + j]).
+ * nr is two 256-bit vectors of T. The generic version is written for
+ * the compiler to vectorize; AVX builds (icc -xHost, g++ -mavx2 -mfma)
+ * use the intrinsics below. */
+template <typename T>
+struct CholeskyKernel
+{
+    static const size_t mr = 4;
+    static const size_t nr = 64 / sizeof(T);
+
+    static void run(size_t kc, const T *a, const T *b, T *c)
+    {
+        T acc[mr][nr];
+        for (size_t r = 0; r < mr; r++)
+        {
+            for (size_t j = 0; j < nr; j++)
+            {
+                acc[r][j] = 0;
+            }
+        }
+        for (size_t p = 0; p < kc; p++, a += mr, b += nr)
+        {
+            for (size_t r = 0; r < mr; r++)
+            {
+                for (size_t j = 0; j < nr; j++)
+                {
+                    acc[r][j] += a[r] * b[j];
+                }
+            }
+        }
+        for (size_t r = 0; r < mr; r++)
+        {
+            for (size_t j = 0; j < nr; j++)
+            {
+                c[r * nr + j] = acc[r][j];
+            }
+        }
+    }
+};
+
+#if defined(__AVX__)
+    #if defined(__FMA__)
+        #define CHOLESKY_FMADD_PD(a, b, c) _mm256_fmadd_pd(a, b, c)
+        #define CHOLESKY_FMADD_PS(a, b, c) _mm256_fmadd_ps(a, b, c)
+    #else
+        #define CHOLESKY_FMADD_PD(a, b, c) _mm256_add_pd(_mm256_mul_pd(a, b), c)
+        #define CHOLESKY_FMADD_PS(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+    #endif
+
+template <>
+inline void CholeskyKernel<double>::run(size_t kc, const double *a, const double *b, double *c)
+{
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    for (size_t p = 0; p < kc; p++, a += 4, b += 8)
+    {
+        const __m256d b0 = _mm256_loadu_pd(b);
+        const __m256d b1 = _mm256_loadu_pd(b + 4);
+        __m256d ar       = _mm256_broadcast_sd(a);
+        c00              = CHOLESKY_FMADD_PD(ar, b0, c00);
+        c01              = CHOLESKY_FMADD_PD(ar, b1, c01);
+        ar               = _mm256_broadcast_sd(a + 1);
+        c10              = CHOLESKY_FMADD_PD(ar, b0, c10);
+        c11              = CHOLESKY_FMADD_PD(ar, b1, c11);
+        ar               = _mm256_broadcast_sd(a + 2);
+        c20              = CHOLESKY_FMADD_PD(ar, b0, c20);
+        c21              = CHOLESKY_FMADD_PD(ar, b1, c21);
+        ar               = _mm256_broadcast_sd(a + 3);
+        c30              = CHOLESKY_FMADD_PD(ar, b0, c30);
+        c31              = CHOLESKY_FMADD_PD(ar, b1, c31);
+    }
+    _mm256_storeu_pd(c, c00);
+    _mm256_storeu_pd(c + 4, c01);
+    _mm256_storeu_pd(c + 8, c10);
+    _mm256_storeu_pd(c + 12, c11);
+    _mm256_storeu_pd(c + 16, c20);
+    _mm256_storeu_pd(c + 20, c21);
+    _mm256_storeu_pd(c + 24, c30);
+    _mm256_storeu_pd(c + 28, c31);
+}
+
+template <>
+inline void CholeskyKernel<float>::run(size_t kc, const float *a, const float *b, float *c)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    for (size_t p = 0; p < kc; p++, a += 4, b += 16)
+    {
+        const __m256 b0 = _mm256_loadu_ps(b);
+        const __m256 b1 = _mm256_loadu_ps(b + 8);
+        __m256 ar       = _mm256_broadcast_ss(a);
+        c00             = CHOLESKY_FMADD_PS(ar, b0, c00);
+        c01             = CHOLESKY_FMADD_PS(ar, b1, c01);
+        ar              = _mm256_broadcast_ss(a + 1);
+        c10             = CHOLESKY_FMADD_PS(ar, b0, c10);
+        c11             = CHOLESKY_FMADD_PS(ar, b1, c11);
+        ar              = _mm256_broadcast_ss(a + 2);
+        c20             = CHOLESKY_FMADD_PS(ar, b0, c20);
+        c21             = CHOLESKY_FMADD_PS(ar, b1, c21);
+        ar              = _mm256_broadcast_ss(a + 3);
+        c30             = CHOLESKY_FMADD_PS(ar, b0, c30);
+        c31             = CHOLESKY_FMADD_PS(ar, b1, c31);
+    }
+    _mm256_storeu_ps(c, c00);
+    _mm256_storeu_ps(c + 8, c01);
+    _mm256_storeu_ps(c + 16, c10);
+    _mm256_storeu_ps(c + 24, c11);
+    _mm256_storeu_ps(c + 32, c20);
+    _mm256_storeu_ps(c + 40, c21);
+    _mm256_storeu_ps(c + 48, c30);
+    _mm256_storeu_ps(c + 56, c31);
+}
+#endif
+
+/* L2 size in bytes, 256 KiB when the system does not say */
+inline size_t l2CacheSize()
+{
+    long size = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    return size > 0 ? (size_t)size : 256 * 1024;
+}
+
+/* Panel width: an nb x nb block of doubles takes 1/16 of L2, so that
+ * the diagonal block and the panel rows a thread solves against it stay
+ * in L2 (128 for 2 MiB), between 32 and 256. Not wider for float: the
+ * panel work, which grows with nb, is no faster in float. */
+template <typename T>
+size_t choleskyBlockSize()
+{
+    static const size_t nb =
+        std::min<size_t>(256, std::max<size_t>(32, (size_t)sqrt(l2CacheSize() / (16.0 * sizeof(double))) / CholeskyKernel<T>::mr * CholeskyKernel<T>::mr));
+    return nb;
+}
+
+/* Four partial sums: the compilers do not reorder a floating point
+ * reduction to vectorize it on their own */
+template <typename T>
+inline T choleskyDot(const T *x, const T *y, size_t n)
+{
+    T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t p = 0;
+    for (; p + 4 <= n; p += 4)
+    {
+        s0 += x[p] * y[p];
+        s1 += x[p + 1] * y[p + 1];
+        s2 += x[p + 2] * y[p + 2];
+        s3 += x[p + 3] * y[p + 3];
+    }
+    for (; p < n; p++)
+    {
+        s0 += x[p] * y[p];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+/* The storages of a triangle: rows(i) points to where element (i, 0) of
+ * row i would be, so that rows(i)[j] is element (i, j) for every j the
+ * triangle has in row i */
+
+/* row-major, leading dimension lda */
+template <typename T>
+struct CholeskyFullRows
+{
+    typedef T Value;
+    T *a;
+    size_t lda;
+
+    CholeskyFullRows(T *a, size_t lda) : a(a), lda(lda) {}
+    T *operator()(size_t i) const { return a + i * lda; }
+};
+
+/* lower triangle packed by rows: (i, j), j <= i, at i * (i + 1) / 2 + j */
+template <typename T>
+struct CholeskyPackedLowerRows
+{
+    typedef T Value;
+    T *a;
+
+    explicit CholeskyPackedLowerRows(T *a) : a(a) {}
+    T *operator()(size_t i) const { return a + i * (i + 1) / 2; }
+};
+
+/* upper triangle of order n packed by rows: (i, j), j >= i, at
+ * i * n - i * (i - 1) / 2 + j - i */
+template <typename T>
+struct CholeskyPackedUpperRows
+{
+    typedef T Value;
+    T *a;
+    size_t n;
+
+    CholeskyPackedUpperRows(T *a, size_t n) : a(a), n(n) {}
+    T *operator()(size_t i) const { return a + i * n - i * (i + 1) / 2; }
+};
+
+/* Unblocked (Crout) factorization of the b x b lower block at (k, k),
+ * rows of contiguous dot products. Returns 0 or the failing column + 1
+ * of the block. */
+template <typename Rows>
+size_t choleskyDiagonalBlock(const Rows &rows, size_t k, size_t b)
+{
+    typedef typename Rows::Value T;
+    for (size_t j = 0; j < b; j++)
+    {
+        T *aj   = rows(k + j) + k;
+        T pivot = aj[j] - choleskyDot(aj, aj, j);
+        if (!(pivot > 0))
+        {
+            return j + 1;
+        }
+        aj[j] = std::sqrt(pivot);
+
+        const T inverse = T(1) / aj[j];
+        for (size_t i = j + 1; i < b; i++)
+        {
+            T *ai = rows(k + i) + k;
+            ai[j] = (ai[j] - choleskyDot(ai, aj, j)) * inverse;
+        }
+    }
+    return 0;
+}
+
+/* x = x * L^-T for the b x b lower triangular L at (k, k) */
+template <typename Rows>
+inline void choleskySolveRow(typename Rows::Value *x, const Rows &rows, size_t k, size_t b)
+{
+    for (size_t c = 0; c < b; c++)
+    {
+        const typename Rows::Value *lc = rows(k + c) + k;
+        x[c]                           = (x[c] - choleskyDot(x, lc, c)) / lc[c];
+    }
+}
+
+/* Factors the lower triangle of a symmetric positive definite matrix of
+ * order n, in any storage, in place into the L of A = L * L^T.
+ *
+ * Right-looking and blocked by choleskyBlockSize<T>() columns (or
+ * blockSize): the diagonal block is factored, the rows below it solved
+ * against it in parallel and packed for CholeskyKernel<T>, then the
+ * trailing lower triangle is updated by C -= L21 * L21^T in mr x nr
+ * register blocks. Each thread sweeps its rows once per group of
+ * column blocks that fits in half of L2, and takes pairs of short and
+ * long rows so that the triangle is shared evenly.
+ *
+ * Returns 0, or j + 1 when the leading minor of order j + 1 is not
+ * positive definite; a is then partly overwritten. */
+template <typename Rows>
+size_t choleskyFactorizeLower(const Rows &rows, size_t n, unsigned int nThreads = 0, size_t blockSize = 0)
+{
+    typedef typename Rows::Value T;
+    typedef CholeskyKernel<T> Kernel;
+    const size_t mr = Kernel::mr, nr = Kernel::nr;
+    const size_t nb = blockSize ? blockSize : choleskyBlockSize<T>();
+    nThreads        = getNumberOfThreads(nThreads);
+
+    std::vector<T> packedA, packedB;
+    for (size_t k = 0; k < n; k += nb)
+    {
+        const size_t b     = std::min(nb, n - k);
+        const size_t error = choleskyDiagonalBlock(rows, k, b);
+        if (error)
+        {
+            return k + error;
+        }
+
+        const size_t first = k + b; /* first row of the trailing matrix */
+        const size_t m     = n - first;
+        if (m == 0)
+        {
+            break;
+        }
+
+        /* L21 = A21 * L11^-T row by row, packed zero-padded by mr and by nr rows */
+        const size_t mStrips = (m + mr - 1) / mr, nStrips = (m + nr - 1) / nr;
+        packedA.assign(mStrips * mr * b, T(0));
+        packedB.assign(nStrips * nr * b, T(0));
+        parallelFor(m, 64, nThreads, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                T *x = rows(first + i) + k;
+                choleskySolveRow(x, rows, k, b);
+                T *pa = &packedA[(i / mr) * mr * b + i % mr];
+                T *pb = &packedB[(i / nr) * nr * b + i % nr];
+                for (size_t p = 0; p < b; p++)
+                {
+                    pa[p * mr] = x[p];
+                    pb[p * nr] = x[p];
+                }
+            }
+        });
+
+        /* A22 -= L21 * L21^T, lower triangle */
+        const size_t groupStrips = std::max<size_t>(1, l2CacheSize() / 2 / (nr * b * sizeof(T)));
+        const size_t nTasks      = (mStrips + 1) / 2;
+        parallelFor(nTasks, 1, nThreads, [&](size_t begin, size_t end) {
+            T c[mr * nr];
+            for (size_t g = 0; g < nStrips; g += groupStrips)
+            {
+                for (size_t task = begin; task < end; task++)
+                {
+                    for (size_t half = 0; half < 2; half++)
+                    {
+                        const size_t s = half ? mStrips - 1 - task : task;
+                        if (half && s == task)
+                        {
+                            break;
+                        }
+                        const size_t i0   = s * mr;
+                        const size_t height = std::min(mr, m - i0);
+                        /* the column strips of this group left of the row strip's last row */
+                        const size_t last = std::min(std::min(g + groupStrips, nStrips), (i0 + height - 1) / nr + 1);
+                        for (size_t t = g; t < last; t++)
+                        {
+                            Kernel::run(b, &packedA[s * mr * b], &packedB[t * nr * b], c);
+                            const size_t j0 = t * nr;
+                            for (size_t r = 0; r < height; r++)
+                            {
+                                T *ci              = rows(first + i0 + r) + first;
+                                const size_t jLast = std::min(j0 + nr, i0 + r + 1);
+                                for (size_t j = j0; j < jLast; j++)
+                                {
+                                    ci[j] -= c[r * nr + j - j0];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+    return 0;
+}
+
+/* Factors the symmetric positive definite n x n matrix a (row-major,
+ * leading dimension lda, only the lower triangle read) in place into
+ * the lower triangular L of A = L * L^T, and zeroes the strict upper
+ * triangle. choleskyFactorizeLower on the rows of a.
+ *
+ * Returns 0, or j + 1 when the leading minor of order j + 1 is not
+ * positive definite; a is then partly overwritten. */
+template <typename T>
+size_t choleskyFactorize(T *a, size_t n, size_t lda, unsigned int nThreads = 0, size_t blockSize = 0)
+{
+    const size_t error = choleskyFactorizeLower(CholeskyFullRows<T>(a, lda), n, nThreads, blockSize);
+    if (error)
+    {
+        return error;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        std::fill(a + i * lda + i + 1, a + i * lda + n, T(0));
+    }
+    return 0;
+}
+
+/* Factors the upper triangle of a symmetric positive definite matrix of
+ * order n, in any storage, in place into the U of A = U^T * U: the same
+ * steps as choleskyFactorizeLower on the transpose, so that every loop
+ * runs along rows of U.
+ *
+ * The diagonal block is factored right-looking, U12 = U11^-T * A12 is
+ * solved in parallel by column chunks of the block rows with row
+ * updates and packed for CholeskyKernel<T>, then the trailing upper
+ * triangle is updated by C -= U12^T * U12 like the lower one.
+ *
+ * Returns like choleskyFactorizeLower. */
+template <typename Rows>
+size_t choleskyFactorizeUpper(const Rows &rows, size_t n, unsigned int nThreads = 0, size_t blockSize = 0)
+{
+    typedef typename Rows::Value T;
+    typedef CholeskyKernel<T> Kernel;
+    const size_t mr = Kernel::mr, nr = Kernel::nr;
+    const size_t nb = blockSize ? blockSize : choleskyBlockSize<T>();
+    nThreads        = getNumberOfThreads(nThreads);
+
+    std::vector<T> packedA, packedB;
+    for (size_t k = 0; k < n; k += nb)
+    {
+        const size_t b     = std::min(nb, n - k);
+        const size_t first = k + b; /* first column of the trailing matrix */
+
+        /* U11, row j scaled then subtracted from the rows below it */
+        for (size_t j = k; j < first; j++)
+        {
+            T *uj       = rows(j);
+            const T ajj = uj[j];
+            if (!(ajj > 0))
+            {
+                return j + 1;
+            }
+            uj[j]           = std::sqrt(ajj);
+            const T inverse = T(1) / uj[j];
+            for (size_t c = j + 1; c < first; c++)
+            {
+                uj[c] *= inverse;
+            }
+            for (size_t i = j + 1; i < first; i++)
+            {
+                T *ui       = rows(i);
+                const T uji = uj[i];
+                for (size_t c = i; c < first; c++)
+                {
+                    ui[c] -= uji * uj[c];
+                }
+            }
+        }
+
+        const size_t m = n - first;
+        if (m == 0)
+        {
+            break;
+        }
+
+        /* U12 = U11^-T * A12 by chunks of nr columns, packed zero-padded
+         * by mr and by nr columns */
+        const size_t mStrips = (m + mr - 1) / mr, nStrips = (m + nr - 1) / nr;
+        packedA.assign(mStrips * mr * b, T(0));
+        packedB.assign(nStrips * nr * b, T(0));
+        parallelFor(nStrips, 1, nThreads, [&](size_t begin, size_t end) {
+            const size_t c0 = first + begin * nr, c1 = std::min(n, first + end * nr);
+            for (size_t j = k; j < first; j++)
+            {
+                T *uj           = rows(j);
+                const T inverse = T(1) / uj[j];
+                for (size_t c = c0; c < c1; c++)
+                {
+                    uj[c] *= inverse;
+                }
+                for (size_t i = j + 1; i < first; i++)
+                {
+                    T *ui       = rows(i);
+                    const T uji = uj[i];
+                    for (size_t c = c0; c < c1; c++)
+                    {
+                        ui[c] -= uji * uj[c];
+                    }
+                }
+                const size_t p = j - k;
+                for (size_t c = c0; c < c1; c++)
+                {
+                    const size_t i                               = c - first;
+                    packedA[(i / mr) * mr * b + p * mr + i % mr] = uj[c];
+                    packedB[(i / nr) * nr * b + p * nr + i % nr] = uj[c];
+                }
+            }
+        });
+
+        /* A22 -= U12^T * U12, upper triangle */
+        const size_t groupStrips = std::max<size_t>(1, l2CacheSize() / 2 / (nr * b * sizeof(T)));
+        const size_t nTasks      = (mStrips + 1) / 2;
+        parallelFor(nTasks, 1, nThreads, [&](size_t begin, size_t end) {
+            T c[mr * nr];
+            for (size_t g = 0; g < nStrips; g += groupStrips)
+            {
+                for (size_t task = begin; task < end; task++)
+                {
+                    for (size_t half = 0; half < 2; half++)
+                    {
+                        const size_t s = half ? mStrips - 1 - task : task;
+                        if (half && s == task)
+                        {
+                            break;
+                        }
+                        const size_t i0     = s * mr;
+                        const size_t height = std::min(mr, m - i0);
+                        /* the column strips of this group right of the row strip's first row */
+                        for (size_t t = std::max(g, i0 / nr); t < std::min(g + groupStrips, nStrips); t++)
+                        {
+                            Kernel::run(b, &packedA[s * mr * b], &packedB[t * nr * b], c);
+                            const size_t j0   = t * nr;
+                            const size_t jEnd = std::min(j0 + nr, m);
+                            for (size_t r = 0; r < height; r++)
+                            {
+                                T *ci = rows(first + i0 + r) + first;
+                                for (size_t j = std::max(j0, i0 + r); j < jEnd; j++)
+                                {
+                                    ci[j] -= c[r * nr + j - j0];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+    return 0;
+}
+
+/* Which triangle a packed matrix holds */
+enum CholeskyTriangle
+{
+    choleskyLower, /* L of A = L * L^T, CholeskyPackedLowerRows */
+    choleskyUpper  /* U of A = U^T * U, CholeskyPackedUpperRows */
+};
+
+/* Factors in place the symmetric positive definite matrix of order n
+ * whose lower or upper triangle is packed by rows in ap, n * (n + 1) / 2
+ * values (the lower triangle packed by rows is the upper one packed by
+ * columns, as LAPACK's 'U' packed storage). Half of the memory and of
+ * the traffic of choleskyFactorize.
+ *
+ * Returns like choleskyFactorize. */
+template <typename T>
+size_t choleskyFactorizePacked(T *ap, size_t n, CholeskyTriangle triangle, unsigned int nThreads = 0, size_t blockSize = 0)
+{
+    if (triangle == choleskyUpper)
+    {
+        return choleskyFactorizeUpper(CholeskyPackedUpperRows<T>(ap, n), n, nThreads, blockSize);
+    }
+    return choleskyFactorizeLower(CholeskyPackedLowerRows<T>(ap), n, nThreads, blockSize);
+}
+
+/* Copies the lower (choleskyLower) or upper triangle of the n x n
+ * row-major a into packed rows, and back */
+template <typename T, typename U>
+void choleskyPackTriangle(const T *a, size_t n, size_t lda, CholeskyTriangle triangle, U *ap)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const size_t j0 = triangle == choleskyLower ? 0 : i, j1 = triangle == choleskyLower ? i + 1 : n;
+        for (size_t j = j0; j < j1; j++)
+        {
+            *ap++ = (U)a[i * lda + j];
+        }
+    }
+}
+
+template <typename T, typename U>
+void choleskyUnpackTriangle(const T *ap, size_t n, CholeskyTriangle triangle, U *a, size_t lda)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const size_t j0 = triangle == choleskyLower ? 0 : i, j1 = triangle == choleskyLower ? i + 1 : n;
+        std::fill(a + i * lda, a + i * lda + n, U(0));
+        for (size_t j = j0; j < j1; j++)
+        {
+            a[i * lda + j] = (U)*ap++;
+        }
+    }
+}
+
+/* rows x kc of x (leading dimension ld) packed by width rows, p-major
+ * and zero-padded, as CholeskyKernel<T> reads them */
+template <typename T>
+void choleskyPack(const T *x, size_t rows, size_t kc, size_t ld, size_t width, T *packed)
+{
+    const size_t strips = (rows + width - 1) / width;
+    std::fill(packed, packed + strips * width * kc, T(0));
+    for (size_t i = 0; i < rows; i++)
+    {
+        T *p = packed + (i / width) * width * kc + i % width;
+        for (size_t q = 0; q < kc; q++)
+        {
+            p[q * width] = x[i * ld + q];
+        }
+    }
+}
+
+/* rows x cols of c -= A * B^T from A and B packed by choleskyPack, only
+ * j <= i when lower */
+template <typename T>
+void choleskyTileUpdate(T *c, size_t ldc, size_t rows, size_t cols, const T *packedA, const T *packedB, size_t kc, bool lower)
+{
+    typedef CholeskyKernel<T> Kernel;
+    const size_t mr = Kernel::mr, nr = Kernel::nr;
+    T block[mr * nr];
+    for (size_t i0 = 0; i0 < rows; i0 += mr)
+    {
+        const size_t iEnd = std::min(i0 + mr, rows);
+        for (size_t j0 = 0; j0 < cols && (!lower || j0 < iEnd); j0 += nr)
+        {
+            Kernel::run(kc, packedA + i0 * kc, packedB + j0 * kc, block);
+            for (size_t i = i0; i < iEnd; i++)
+            {
+                T *ci             = c + i * ldc;
+                const size_t jEnd = std::min(j0 + nr, lower ? i + 1 : cols);
+                for (size_t j = j0; j < jEnd; j++)
+                {
+                    ci[j] -= block[(i - i0) * nr + j - j0];
+                }
+            }
+        }
+    }
+}
+
+/* A task of choleskyFactorizeTiled on tile (i, j) at step k */
+struct CholeskyTask
+{
+    enum Kind
+    {
+        potrf, /* factor the diagonal tile (k, k) */
+        trsm,  /* solve tile (i, k) against it */
+        update /* tile (i, j) -= L(i, k) * L(j, k)^T: SYRK if i == j, else GEMM */
+    };
+    int kind;
+    unsigned int i, j, k;
+};
+
+/* The same factorization as choleskyFactorize, as a graph of tile tasks
+ * run by runTasks (parallel.h) instead of one parallel step per panel.
+ *
+ * With t tiles of tileSize (default choleskyBlockSize<T>()) per side,
+ * a task starts as soon as its inputs are final: POTRF(k) after the
+ * last update of tile (k, k), TRSM(i, k) after POTRF(k) and the last
+ * update of tile (i, k), and the k-th update of tile (i, j) after
+ * TRSM(i, k), TRSM(j, k) and update k - 1 of the tile. The updates of
+ * one tile are thus serialized in k order, and the next panels are
+ * factored while the updates of the previous steps still run. Tasks
+ * that lead to the next panel are queued last, so that their thread
+ * runs them first.
+ *
+ * Returns like choleskyFactorize. */
+template <typename T>
+size_t choleskyFactorizeTiled(T *a, size_t n, size_t lda, unsigned int nThreads = 0, size_t tileSize = 0)
+{
+    typedef CholeskyKernel<T> Kernel;
+    const size_t nb = tileSize ? tileSize : choleskyBlockSize<T>();
+    const size_t t  = (n + nb - 1) / nb;
+    if (t == 0)
+    {
+        return 0;
+    }
+
+    /* unresolved inputs per task; the updates of step k are the lower
+     * triangle of the trailing tiles, from updateOffset[k] */
+    std::vector<std::atomic<int> > potrfDeps(t), trsmDeps(t * t);
+    std::vector<size_t> updateOffset(t + 1, 0);
+    for (size_t k = 0; k < t; k++)
+    {
+        const size_t m      = t - 1 - k;
+        updateOffset[k + 1] = updateOffset[k] + m * (m + 1) / 2;
+    }
+    std::vector<std::atomic<int> > updateDeps(updateOffset[t]);
+    auto updateIndex = [&](size_t i, size_t j, size_t k) {
+        const size_t ii = i - k - 1, jj = j - k - 1;
+        return updateOffset[k] + ii * (ii + 1) / 2 + jj;
+    };
+    for (size_t k = 0; k < t; k++)
+    {
+        potrfDeps[k].store(k > 0 ? 1 : 0);
+        for (size_t i = k + 1; i < t; i++)
+        {
+            trsmDeps[i * t + k].store(k > 0 ? 2 : 1);
+            for (size_t j = k + 1; j <= i; j++)
+            {
+                updateDeps[updateIndex(i, j, k)].store((i == j ? 1 : 2) + (k > 0 ? 1 : 0));
+            }
+        }
+    }
+
+    std::atomic<size_t> error(0);
+    const CholeskyFullRows<T> full(a, lda);
+    auto tile = [&](size_t i, size_t j) { return a + i * nb * lda + j * nb; };
+    auto size = [&](size_t i) { return std::min(nb, n - i * nb); };
+
+    std::vector<CholeskyTask> initial(1);
+    initial[0].kind = CholeskyTask::potrf;
+    initial[0].i = initial[0].j = initial[0].k = 0;
+
+    runTasks(initial, nThreads, [&](const CholeskyTask &task, std::function<void(const CholeskyTask &)> spawn) {
+        auto release = [&](std::atomic<int> &deps, int kind, size_t i, size_t j, size_t k) {
+            if (deps.fetch_sub(1) == 1)
+            {
+                CholeskyTask next;
+                next.kind = kind;
+                next.i    = (unsigned int)i;
+                next.j    = (unsigned int)j;
+                next.k    = (unsigned int)k;
+                spawn(next);
+            }
+        };
+        const size_t i = task.i, j = task.j, k = task.k;
+        const bool failed = error.load() != 0;
+
+        if (task.kind == CholeskyTask::potrf)
+        {
+            const size_t info = failed ? 0 : choleskyDiagonalBlock(full, k * nb, size(k));
+            if (info)
+            {
+                error.store(k * nb + info);
+            }
+            for (size_t r = t - 1; r > k; r--)
+            {
+                release(trsmDeps[r * t + k], CholeskyTask::trsm, r, k, k);
+            }
+        }
+        else if (task.kind == CholeskyTask::trsm)
+        {
+            if (!failed)
+            {
+                T *x = tile(i, k);
+                for (size_t r = 0; r < size(i); r++)
+                {
+                    choleskySolveRow(x + r * lda, full, k * nb, size(k));
+                }
+            }
+            /* as the column operand of updates (r, i) and the row operand
+             * of updates (i, c), (i, k + 1) last: it leads to the next
+             * panel */
+            for (size_t r = t - 1; r > i; r--)
+            {
+                release(updateDeps[updateIndex(r, i, k)], CholeskyTask::update, r, i, k);
+            }
+            for (size_t c = i; c > k; c--)
+            {
+                release(updateDeps[updateIndex(i, c, k)], CholeskyTask::update, i, c, k);
+            }
+        }
+        else
+        {
+            if (!failed)
+            {
+                static thread_local std::vector<T> packedA, packedB;
+                const size_t kc = size(k);
+                packedA.resize((nb + Kernel::mr) * kc);
+                packedB.resize((nb + Kernel::nr) * kc);
+                choleskyPack(tile(i, k), size(i), kc, lda, Kernel::mr, &packedA[0]);
+                choleskyPack(tile(j, k), size(j), kc, lda, Kernel::nr, &packedB[0]);
+                choleskyTileUpdate(tile(i, j), lda, size(i), size(j), &packedA[0], &packedB[0], kc, i == j);
+            }
+            if (j == k + 1)
+            {
+                if (i == j)
+                {
+                    release(potrfDeps[j], CholeskyTask::potrf, j, j, j);
+                }
+                else
+                {
+                    release(trsmDeps[i * t + j], CholeskyTask::trsm, i, j, j);
+                }
+            }
+            else
+            {
+                release(updateDeps[updateIndex(i, j, k + 1)], CholeskyTask::update, i, j, k + 1);
+            }
+        }
+    });
+
+    if (error.load())
+    {
+        return error.load();
+    }
+    for (size_t r = 0; r < n; r++)
+    {
+        std::fill(a + r * lda + r + 1, a + r * lda + n, T(0));
+    }
+    return 0;
+}
+
+
+/* Matrices factored side by side by choleskyFactorizeBatch: one 256-bit
+ * vector of T */
+template <typename T>
+struct CholeskyBatchLanes
+{
+    static const size_t value = 32 / sizeof(T);
+};
+
+/* Factors lanes matrices of order n at once, interleaved: element (i, j)
+ * of matrix l at a[(i * n + j) * lanes + l], lower triangle. Every
+ * operation is the same across the lanes, so the innermost loops are
+ * one vector wide. N > 0 fixes the order at compile time (N == n) for
+ * fully unrolled loops. A lane whose pivot is not positive gets
+ * info[l] = column + 1 and continues on a pivot of 1, so that the
+ * others are not held up. */
+template <typename T, size_t N>
+void choleskyInterleaved(T *a, size_t n, size_t *info)
+{
+    const size_t W     = CholeskyBatchLanes<T>::value;
+    const size_t order = N ? N : n;
+    T inverse[W];
+    for (size_t j = 0; j < order; j++)
+    {
+        T *ajj = a + (j * order + j) * W;
+        for (size_t p = 0; p < j; p++)
+        {
+            const T *ajp = a + (j * order + p) * W;
+            for (size_t l = 0; l < W; l++)
+            {
+                ajj[l] -= ajp[l] * ajp[l];
+            }
+        }
+        for (size_t l = 0; l < W; l++)
+        {
+            if (!(ajj[l] > 0))
+            {
+                info[l] = info[l] ? info[l] : j + 1;
+                ajj[l]  = 1;
+            }
+        }
+        for (size_t l = 0; l < W; l++)
+        {
+            ajj[l]     = std::sqrt(ajj[l]);
+            inverse[l] = T(1) / ajj[l];
+        }
+
+        for (size_t i = j + 1; i < order; i++)
+        {
+            T *aij = a + (i * order + j) * W;
+            for (size_t p = 0; p < j; p++)
+            {
+                const T *aip = a + (i * order + p) * W;
+                const T *ajp = a + (j * order + p) * W;
+                for (size_t l = 0; l < W; l++)
+                {
+                    aij[l] -= aip[l] * ajp[l];
+                }
+            }
+            for (size_t l = 0; l < W; l++)
+            {
+                aij[l] *= inverse[l];
+            }
+        }
+    }
+}
+
+/* Factors count independent symmetric positive definite matrices of
+ * order n, stored one after the other (row-major, n * n each, only the
+ * lower triangle read), each in place into its L as choleskyFactorize
+ * does. For the small orders where a call per matrix costs more than
+ * the arithmetic: groups of CholeskyBatchLanes<T>::value matrices are
+ * interleaved into a buffer and factored side by side, with kernels
+ * compiled for orders 2, 3, 4, 6, 8, 12, 16, 24, 32, 48 and 64, the
+ * groups split across threads.
+ *
+ * info, when not NULL, receives per matrix 0 or j + 1 when its leading
+ * minor of order j + 1 is not positive definite (the matrix is then
+ * overwritten with meaningless values). Returns the number of matrices
+ * that failed. */
+template <typename T>
+size_t choleskyFactorizeBatch(T *matrices, size_t count, size_t n, size_t *info = NULL, unsigned int nThreads = 0)
+{
+    const size_t W       = CholeskyBatchLanes<T>::value;
+    const size_t nGroups = (count + W - 1) / W;
+    const size_t size    = n * n;
+    std::atomic<size_t> failed(0);
+
+    void (*kernel)(T *, size_t, size_t *);
+    switch (n)
+    {
+    case 2: kernel = choleskyInterleaved<T, 2>; break;
+    case 3: kernel = choleskyInterleaved<T, 3>; break;
+    case 4: kernel = choleskyInterleaved<T, 4>; break;
+    case 6: kernel = choleskyInterleaved<T, 6>; break;
+    case 8: kernel = choleskyInterleaved<T, 8>; break;
+    case 12: kernel = choleskyInterleaved<T, 12>; break;
+    case 16: kernel = choleskyInterleaved<T, 16>; break;
+    case 24: kernel = choleskyInterleaved<T, 24>; break;
+    case 32: kernel = choleskyInterleaved<T, 32>; break;
+    case 48: kernel = choleskyInterleaved<T, 48>; break;
+    case 64: kernel = choleskyInterleaved<T, 64>; break;
+    default: kernel = choleskyInterleaved<T, 0>;
+    }
+
+    /* groups of about 64 KiB of matrices per task */
+    const size_t grain = std::max<size_t>(1, 65536 / (W * size * sizeof(T) + 1));
+    parallelFor(nGroups, grain, nThreads, [&](size_t begin, size_t end) {
+        std::vector<T> buffer(size * W);
+        size_t groupInfo[W];
+        for (size_t g = begin; g < end; g++)
+        {
+            const size_t first = g * W;
+            const size_t lanes = std::min(W, count - first);
+            T *m               = matrices + first * size;
+
+            /* interleave the lower triangles, each matrix read in order,
+             * identity in the unused lanes of the last group */
+            for (size_t l = 0; l < W; l++)
+            {
+                const T *ml = m + l * size;
+                for (size_t i = 0; i < n; i++)
+                {
+                    T *b = &buffer[i * n * W + l];
+                    for (size_t j = 0; j <= i; j++)
+                    {
+                        b[j * W] = l < lanes ? ml[i * n + j] : T(i == j);
+                    }
+                }
+            }
+            std::fill(groupInfo, groupInfo + W, 0);
+
+            kernel(&buffer[0], n, groupInfo);
+
+            for (size_t l = 0; l < lanes; l++)
+            {
+                T *ml = m + l * size;
+                for (size_t i = 0; i < n; i++)
+                {
+                    const T *b = &buffer[i * n * W + l];
+                    for (size_t j = 0; j <= i; j++)
+                    {
+                        ml[i * n + j] = b[j * W];
+                    }
+                    std::fill(ml + i * n + i + 1, ml + (i + 1) * n, T(0));
+                }
+                if (info)
+                {
+                    info[first + l] = groupInfo[l];
+                }
+                if (groupInfo[l])
+                {
+                    failed.fetch_add(1);
+                }
+            }
+        }
+    });
+    return failed.load();
+}
+
+/* Solves L * X = B (or L^T * X = B when transpose) in place for the
+ * nrhs right-hand sides of the n x nrhs row-major x (leading dimension
+ * ldx), L the lower factor in the rows of a storage of cholesky.h (the
+ * upper triangle is not read).
+ *
+ * Blocked by choleskyBlockSize<T>() rows (or blockSize), in the order
+ * of the substitution: the rows of X in the diagonal block are solved
+ * in parallel by chunks of nr columns and packed, then the rows not yet
+ * solved are updated by X2 -= L21 * X1 (L12^T * X1 when transpose) in
+ * parallel by mr rows with CholeskyKernel<T>. */
+template <typename Rows, typename T>
+void choleskyTriangularSolve(const Rows &rows, size_t n, bool transpose, T *x, size_t nrhs, size_t ldx, unsigned int nThreads = 0,
+                             size_t blockSize = 0)
+{
+    typedef CholeskyKernel<T> Kernel;
+    const size_t mr = Kernel::mr, nr = Kernel::nr;
+    const size_t nb = blockSize ? blockSize : choleskyBlockSize<T>();
+    nThreads        = getNumberOfThreads(nThreads);
+    if (n == 0 || nrhs == 0)
+    {
+        return;
+    }
+
+    const size_t cStrips = (nrhs + nr - 1) / nr;
+    const size_t nBlocks = (n + nb - 1) / nb;
+    std::vector<T> packedB;
+    for (size_t step = 0; step < nBlocks; step++)
+    {
+        const size_t k = (transpose ? nBlocks - 1 - step : step) * nb;
+        const size_t b = std::min(nb, n - k);
+
+        /* X1 = L11^-1 * B1 (L11^-T * B1) by row axpys, packed by nr columns */
+        packedB.assign(cStrips * nr * b, T(0));
+        parallelFor(cStrips, 1, nThreads, [&](size_t begin, size_t end) {
+            const size_t c0 = begin * nr, c1 = std::min(nrhs, end * nr);
+            for (size_t q = 0; q < b; q++)
+            {
+                const size_t i = transpose ? k + b - 1 - q : k + q;
+                const T *li    = rows(i);
+                T *xi          = x + i * ldx;
+                if (!transpose)
+                {
+                    for (size_t p = k; p < i; p++)
+                    {
+                        const T *xp = x + p * ldx;
+                        for (size_t c = c0; c < c1; c++)
+                        {
+                            xi[c] -= li[p] * xp[c];
+                        }
+                    }
+                }
+                const T inverse = T(1) / li[i];
+                for (size_t c = c0; c < c1; c++)
+                {
+                    xi[c] *= inverse;
+                }
+                if (transpose)
+                {
+                    /* row i of L is column i of L^T: done with x_i, remove it from the rows above */
+                    for (size_t p = k; p < i; p++)
+                    {
+                        T *xp = x + p * ldx;
+                        for (size_t c = c0; c < c1; c++)
+                        {
+                            xp[c] -= li[p] * xi[c];
+                        }
+                    }
+                }
+                T *pb = &packedB[(i - k) * nr];
+                for (size_t c = c0; c < c1; c++)
+                {
+                    pb[(c / nr) * nr * b + c % nr] = xi[c];
+                }
+            }
+        });
+
+        /* the rows below the block, or above it when transpose */
+        const size_t first   = transpose ? 0 : k + b;
+        const size_t m       = transpose ? k : n - first;
+        const size_t mStrips = (m + mr - 1) / mr;
+        parallelFor(mStrips, 1, nThreads, [&](size_t begin, size_t end) {
+            std::vector<T> packedA(mr * b);
+            T c[mr * nr];
+            for (size_t s = begin; s < end; s++)
+            {
+                const size_t i0     = first + s * mr;
+                const size_t height = std::min(mr, first + m - i0);
+                std::fill(packedA.begin(), packedA.end(), T(0));
+                for (size_t p = 0; p < b; p++)
+                {
+                    for (size_t r = 0; r < height; r++)
+                    {
+                        /* L(i0 + r, k + p), or L(k + p, i0 + r) when transpose */
+                        packedA[p * mr + r] = transpose ? rows(k + p)[i0 + r] : rows(i0 + r)[k + p];
+                    }
+                }
+                for (size_t t = 0; t < cStrips; t++)
+                {
+                    Kernel::run(b, &packedA[0], &packedB[t * nr * b], c);
+                    const size_t j0 = t * nr, jEnd = std::min(j0 + nr, nrhs);
+                    for (size_t r = 0; r < height; r++)
+                    {
+                        T *xi = x + (i0 + r) * ldx;
+                        for (size_t j = j0; j < jEnd; j++)
+                        {
+                            xi[j] -= c[r * nr + j - j0];
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
+
+/* Solves A * X = B in place for the nrhs right-hand sides of x, given
+ * the n x n row-major L of A = L * L^T (choleskyFactorize): L * Y = B,
+ * then L^T * X = Y. O(n^2) per right-hand side instead of the O(n^3)
+ * of a new factorization. */
+template <typename T>
+void choleskySolve(const T *l, size_t n, size_t lda, T *x, size_t nrhs, size_t ldx, unsigned int nThreads = 0, size_t blockSize = 0)
+{
+    const CholeskyFullRows<const T> rows(l, lda);
+    choleskyTriangularSolve(rows, n, false, x, nrhs, ldx, nThreads, blockSize);
+    choleskyTriangularSolve(rows, n, true, x, nrhs, ldx, nThreads, blockSize);
+}
+
+/* Turns the lower factor of A, in the rows of a storage of cholesky.h,
+ * into the one of A + x * x^T, or of A - x * x^T when downdate, in
+ * O(n^2) instead of a new factorization.
+ *
+ * Column k of L and x are rotated together, k = 0 to n - 1 (LINPACK
+ * dchud / dchdd). Row i only needs the rotations of the rows above it,
+ * so the rows of a block of choleskyBlockSize<T>() are rotated one
+ * after the other, which makes the rotations of the block, then every
+ * row below applies them in parallel along its contiguous row, four
+ * rows at a time to overlap their dependency chains.
+ *
+ * x is not modified. Returns 0, or k + 1 when the downdated matrix is
+ * not positive definite at order k + 1; L is then partly overwritten. */
+template <typename Rows>
+size_t choleskyRankOneUpdate(const Rows &rows, size_t n, const typename Rows::Value *x, bool downdate, unsigned int nThreads = 0,
+                             size_t blockSize = 0)
+{
+    typedef typename Rows::Value T;
+    const size_t nb = blockSize ? blockSize : choleskyBlockSize<T>();
+    const T sign    = downdate ? T(-1) : T(1);
+
+    /* x rotated so far, and the rotations: L(i, k) = (L(i, k) + sign * s_k * x_i) / c_k,
+     * as L(i, k) * alpha_k + beta_k * x_i, then x_i = c_k * x_i - s_k * L(i, k) */
+    std::vector<T> w(x, x + n), cosine(n), sine(n), alpha(n), beta(n);
+    auto rotate = [&](T *li, size_t i, size_t k0, size_t k1) {
+        T wi = w[i];
+        for (size_t k = k0; k < k1; k++)
+        {
+            const T lik = li[k] * alpha[k] + beta[k] * wi;
+            wi          = cosine[k] * wi - sine[k] * lik;
+            li[k]       = lik;
+        }
+        w[i] = wi;
+    };
+    auto rotate4 = [&](size_t i, size_t k0, size_t k1) {
+        T *l0 = rows(i), *l1 = rows(i + 1), *l2 = rows(i + 2), *l3 = rows(i + 3);
+        T w0 = w[i], w1 = w[i + 1], w2 = w[i + 2], w3 = w[i + 3];
+        for (size_t k = k0; k < k1; k++)
+        {
+            const T a = alpha[k], b = beta[k], c = cosine[k], s = sine[k];
+            const T v0 = l0[k] * a + b * w0, v1 = l1[k] * a + b * w1;
+            const T v2 = l2[k] * a + b * w2, v3 = l3[k] * a + b * w3;
+            w0         = c * w0 - s * v0;
+            w1         = c * w1 - s * v1;
+            w2         = c * w2 - s * v2;
+            w3         = c * w3 - s * v3;
+            l0[k]      = v0;
+            l1[k]      = v1;
+            l2[k]      = v2;
+            l3[k]      = v3;
+        }
+        w[i]     = w0;
+        w[i + 1] = w1;
+        w[i + 2] = w2;
+        w[i + 3] = w3;
+    };
+
+    for (size_t k = 0; k < n; k += nb)
+    {
+        const size_t b = std::min(nb, n - k);
+        for (size_t i = k; i < k + b; i++)
+        {
+            T *li = rows(i);
+            rotate(li, i, k, i);
+            const T squared = li[i] * li[i] + sign * w[i] * w[i];
+            if (!(squared > 0))
+            {
+                return i + 1;
+            }
+            const T r = std::sqrt(squared);
+            cosine[i] = r / li[i];
+            sine[i]   = w[i] / li[i];
+            alpha[i]  = li[i] / r;
+            beta[i]   = sign * sine[i] * alpha[i];
+            li[i]     = r;
+        }
+        const size_t first = k + b;
+        parallelFor((n - first + 3) / 4, 16, nThreads, [&](size_t begin, size_t end) {
+            for (size_t i = first + begin * 4; i < std::min(n, first + end * 4); i += 4)
+            {
+                if (i + 4 <= n)
+                {
+                    rotate4(i, k, first);
+                    continue;
+                }
+                for (; i < n; i++)
+                {
+                    rotate(rows(i), i, k, first);
+                }
+            }
+        });
+    }
+    return 0;
+}
+
+/* choleskyRankOneUpdate on the n x n row-major L of choleskyFactorize */
+template <typename T>
+size_t choleskyUpdate(T *l, size_t n, size_t lda, const T *x, unsigned int nThreads = 0)
+{
+    return choleskyRankOneUpdate(CholeskyFullRows<T>(l, lda), n, x, false, nThreads);
+}
+
+template <typename T>
+size_t choleskyDowndate(T *l, size_t n, size_t lda, const T *x, unsigned int nThreads = 0)
+{
+    return choleskyRankOneUpdate(CholeskyFullRows<T>(l, lda), n, x, true, nThreads);
+}
+
+#endif
@@ -1,5 +1,8 @@
 #include "daal.h"
 #include "service.h"
+#include "benchmark.h"
+#include "cholesky.h"
+#include "datagen.h"
 //#include <intrin.h>
 #include <stdint.h>
 
@@ -7,20 +10,74 @@ using namespace std;
 using namespace daal;
 using namespace daal::algorithms;
 
-uint64_t rdtsc() {
-	return __rdtsc();
-}
-
 /* Input data set parameters */
 string datasetFileName = "data/cholesky_data.csv";
 
+/* cholesky_daal batch [n] [count]
+ *
+ * count small matrices of order n (CholeskyRows of datagen.h, seeds 1 to
+ * count), default 100000 of order 8: a cholesky::Batch<> call per matrix,
+ * as the one-matrix benchmark does, against one choleskyFactorizeBatch
+ * call (cholesky.h) for all of them. */
+int choleskyBatch(int argc, char *argv[], const BenchmarkOptions &options)
+{
+    const size_t n     = argc > 2 ? strtoull(argv[2], NULL, 10) : 8;
+    const size_t count = argc > 3 ? strtoull(argv[3], NULL, 10) : 100000;
+    if (n == 0 || count == 0)
+    {
+        cout << "usage: cholesky_daal batch [n] [count]" << endl;
+        return 1;
+    }
+
+    vector<double> matrices(count * n * n), work;
+    for (size_t m = 0; m < count; m++)
+    {
+        CholeskyRows make(n, m + 1);
+        for (size_t i = 0; i < n; i++)
+        {
+            make(i, &matrices[(m * n + i) * n], (int *)NULL);
+        }
+    }
+
+    const double N = n;
+    BenchmarkCase c;
+    c.itemsPerRun = count;
+    c.flopsPerRun = count * N * N * N / 3;
+    c.bytesPerRun = count * (N * N + N * (N + 1) / 2) * sizeof(double);
+    c.setup       = [&]() { work = matrices; };
+
+    c.name = "cholesky_daal/batch/daal";
+    c.run  = [&work, n, count]() {
+        for (size_t m = 0; m < count; m++)
+        {
+            NumericTablePtr matrix(new HomogenNumericTable<double>(&work[m * n * n], n, n));
+            cholesky::Batch<> algorithm;
+            algorithm.input.set(cholesky::data, matrix);
+            algorithm.compute();
+        }
+    };
+    benchmarkRegistry().push_back(c);
+
+    c.name = "cholesky_daal/batch/native";
+    c.run  = [&work, n, count]() { choleskyFactorizeBatch(&work[0], count, n); };
+    benchmarkRegistry().push_back(c);
+
+    runBenchmarks("cholesky_daal batch", options);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
-    checkArguments(argc, argv, 1, &datasetFileName);
+    /* --warmup, --samples, --min-time, --filter, --json (benchmark.h) */
+    BenchmarkOptions options;
+    parseBenchmarkOptions(argc, argv, options);
 
-	//Inicio da medicao de tempo
-	uint64_t uiInicio, uiFim;
-	int iTam = 1000;
+    if (argc > 1 && strcmp(argv[1], "batch") == 0)
+    {
+        return choleskyBatch(argc, argv, options);
+    }
+
+    checkArguments(argc, argv, 1, &datasetFileName);
 
     /* Initialize FileDataSource<CSVFeatureManager> to retrieve the input data from a .csv file */
     FileDataSource<CSVFeatureManager> dataSource(datasetFileName, DataSource::doAllocateNumericTable,
@@ -35,17 +92,54 @@ int main(int argc, char *argv[])
     /* Set input objects for the algorithm */
     algorithm.input.set(cholesky::data, dataSource.getNumericTable());
 
-	uiInicio = rdtsc();
-	for (int i = 0; i < iTam; i++) {
-		/* Compute Cholesky decomposition */
-		algorithm.compute();
-	}
-	uiFim = rdtsc();
+    /* Compute Cholesky decomposition: n^3 / 3 flops, reads the matrix
+     * and writes the factor */
+    const double n = dataSource.getNumericTable()->getNumberOfRows();
+    registerBenchmark("cholesky_daal/compute", [&]() { algorithm.compute(); }, 1, n * n * n / 3,
+                      (n * n + n * (n + 1) / 2) * sizeof(double));
+
+    /* The hand-written engine (cholesky.h) on the same matrix, in place
+     * on a fresh copy for each run */
+    const size_t nRows = dataSource.getNumericTable()->getNumberOfRows();
+    BlockDescriptor<double> block;
+    dataSource.getNumericTable()->getBlockOfRows(0, nRows, readOnly, block);
+    const vector<double> matrix(block.getBlockPtr(), block.getBlockPtr() + nRows * nRows);
+    dataSource.getNumericTable()->releaseBlockOfRows(block);
+    vector<double> factor;
+
+    BenchmarkCase native;
+    native.name        = "cholesky_daal/native";
+    native.setup       = [&]() { factor = matrix; };
+    native.run         = [&]() { choleskyFactorize(&factor[0], nRows, nRows); };
+    native.itemsPerRun = 1;
+    native.flopsPerRun = n * n * n / 3;
+    native.bytesPerRun = (n * n + n * (n + 1) / 2) * sizeof(double);
+    benchmarkRegistry().push_back(native);
+
+    runBenchmarks("cholesky_daal", options);
+
     /* Get computed Cholesky decomposition */
+    algorithm.compute();
     services::SharedPtr<cholesky::Result> res = algorithm.getResult();
 
-    //printNumericTable(res->get(cholesky::choleskyFactor));
+    /* Both factors agree to rounding */
+    factor = matrix;
+    if (choleskyFactorize(&factor[0], nRows, nRows))
+    {
+        cout << "cholesky_daal/native: the matrix is not positive definite" << endl;
+        return 1;
+    }
+    NumericTablePtr daalFactor = res->get(cholesky::choleskyFactor);
+    daalFactor->getBlockOfRows(0, nRows, readOnly, block);
+    double difference = 0, norm = 0;
+    for (size_t i = 0; i < nRows * nRows; i++)
+    {
+        difference = max(difference, fabs(block.getBlockPtr()[i] - factor[i]));
+        norm       = max(norm, fabs(factor[i]));
+    }
+    daalFactor->releaseBlockOfRows(block);
+    printf("cholesky_daal/native: max |L - L_daal| / max |L| = %.3g\n", norm > 0 ? difference / norm : difference);
 
-	cout << (uiFim - uiInicio) / iTam << endl;
+    //printNumericTable(res->get(cholesky::choleskyFactor));
     return 0;
 }
@@ -0,0 +1,124 @@
+// crc32.cpp : throughput of the getCRC32 checksum (service.h) in each
+// implementation of crc32.h, and their agreement with the byte-at-a-time
+// reference
+//
+//  crc32 [size]
+//
+//  size  bytes per run, default 64 MiB of generated data
+//
+// Cases crc32/bytewise, crc32/slicing8, crc32/slicing16, crc32/clmul
+// (when the processor has PCLMULQDQ) and crc32/dispatch (crc32Remainder,
+// what getCRC32 runs); bytes/run and GB/s are the throughput. Then every
+// implementation must give the reference value on all lengths up to 1024
+// at 8 offsets with 3 previous results, and on the whole buffer.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark.h"
+#include "crc32.h"
+#include "datagen.h"
+#include "parallel.h"
+
+using namespace std;
+
+typedef unsigned int (*Crc32Function)(const unsigned char *, size_t, unsigned int);
+
+struct Crc32Implementation
+{
+	const char * name;
+	Crc32Function remainder;
+};
+
+// crc32Clmul needs its target attribute, this one can be taken by address
+unsigned int crc32_dispatch(const unsigned char * p, size_t len, unsigned int res)
+{
+	return crc32Remainder(p, len, res);
+}
+
+#if CRC32_HAS_CLMUL
+unsigned int crc32_clmul(const unsigned char * p, size_t len, unsigned int res)
+{
+	return crc32Clmul(p, len, res);
+}
+#endif
+
+vector<Crc32Implementation> implementations()
+{
+	vector<Crc32Implementation> list;
+	Crc32Implementation bytewise = { "bytewise", crc32Bytewise };
+	Crc32Implementation slicing8 = { "slicing8", crc32Slicing8 };
+	Crc32Implementation slicing16 = { "slicing16", crc32Slicing16 };
+	Crc32Implementation dispatch = { "dispatch", crc32_dispatch };
+	list.push_back(bytewise);
+	list.push_back(slicing8);
+	list.push_back(slicing16);
+#if CRC32_HAS_CLMUL
+	if (crc32ClmulSupported())
+	{
+		Crc32Implementation clmul = { "clmul", crc32_clmul };
+		list.push_back(clmul);
+	}
+#endif
+	list.push_back(dispatch);
+	return list;
+}
+
+bool check(const Crc32Implementation & implementation, const vector<unsigned char> & data)
+{
+	const unsigned int previous[] = { 0, 0x12345678, 0xFFFFFFFF };
+	size_t failed = 0;
+	for (size_t offset = 0; offset < 8; offset++)
+		for (size_t len = 0; len <= 1024 && offset + len <= data.size(); len++)
+			for (int r = 0; r < 3; r++)
+				failed += implementation.remainder(&data[offset], len, previous[r]) != crc32Bytewise(&data[offset], len, previous[r]);
+	failed += implementation.remainder(&data[0], data.size(), 0) != crc32Bytewise(&data[0], data.size(), 0);
+	printf("crc32/%s: %zu mismatches %s\n", implementation.name, failed, failed ? "FAILED" : "ok");
+	return failed == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	// --warmup, --samples, --min-time, --filter, --json (benchmark.h)
+	BenchmarkOptions options;
+	parseBenchmarkOptions(argc, argv, options);
+
+	const size_t size = argc > 1 ? strtoull(argv[1], NULL, 10) : 64 << 20;
+	if (size == 0)
+	{
+		cout << "usage: crc32 [size]" << endl;
+		return 1;
+	}
+
+	// 8 random bytes per mixBits (datagen.h) value
+	vector<unsigned char> data(size);
+	parallelFor((size + 7) / 8, 4096, 0, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			uint64_t bits = mixBits(i);
+			for (size_t b = i * 8; b < min(size, i * 8 + 8); b++, bits >>= 8)
+				data[b] = (unsigned char)bits;
+		}
+	});
+
+	const vector<Crc32Implementation> list = implementations();
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		const Crc32Function remainder = list[i].remainder;
+		BenchmarkCase c;
+		c.name = string("crc32/") + list[i].name;
+		c.itemsPerRun = 1;
+		c.bytesPerRun = (double)size;
+		c.run = [&data, remainder]() { benchmarkKeep(crc32Finish(remainder(&data[0], data.size(), 0))); };
+		benchmarkRegistry().push_back(c);
+	}
+	runBenchmarks("crc32", options);
+
+	bool ok = true;
+	for (size_t i = 0; i < list.size(); i++)
+		ok = check(list[i], data) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+/* file: crc32.h */
+/*
+!  Content:
+!    The checksum of getCRC32 (service.h): the byte-at-a-time reference,
+!    slicing-by-8 and by-16 tables, and PCLMULQDQ folding chosen at run
+!    time, all bit-identical
+!******************************************************************************/
+
+#ifndef _CRC32_H
+#define _CRC32_H
+
+#include <cstddef>
+
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <cpuid.h>
+    #include <immintrin.h>
+    #define CRC32_HAS_CLMUL 1
+#else
+    #define CRC32_HAS_CLMUL 0
+#endif
+
+/* getCRC32 reads its len bytes backwards, p[len - 1] first, and keeps
+ * res = (res * x^8 + byte) mod Q, Q = x^32 + 0x741B8CD6 (0xBA0DC66B
+ * shifted left by one): crcRem[h] = h * x^32 mod Q. A final remainder
+ * not below crcPoly has crcPoly removed once. */
+static const unsigned int crcPoly = 0xBA0DC66B;
+
+static const unsigned int crcRem[] =
+{
+    0x00000000, 0x741B8CD6, 0xE83719AC, 0x9C2C957A, 0xA475BF8E, 0xD06E3358, 0x4C42A622, 0x38592AF4,
+    0x3CF0F3CA, 0x48EB7F1C, 0xD4C7EA66, 0xA0DC66B0, 0x98854C44, 0xEC9EC092, 0x70B255E8, 0x04A9D93E,
+    0x79E1E794, 0x0DFA6B42, 0x91D6FE38, 0xE5CD72EE, 0xDD94581A, 0xA98FD4CC, 0x35A341B6, 0x41B8CD60,
+    0x4511145E, 0x310A9888, 0xAD260DF2, 0xD93D8124, 0xE164ABD0, 0x957F2706, 0x0953B27C, 0x7D483EAA,
+    0xF3C3CF28, 0x87D843FE, 0x1BF4D684, 0x6FEF5A52, 0x57B670A6, 0x23ADFC70, 0xBF81690A, 0xCB9AE5DC,
+    0xCF333CE2, 0xBB28B034, 0x2704254E, 0x531FA998, 0x6B46836C, 0x1F5D0FBA, 0x83719AC0, 0xF76A1616,
+    0x8A2228BC, 0xFE39A46A, 0x62153110, 0x160EBDC6, 0x2E579732, 0x5A4C1BE4, 0xC6608E9E, 0xB27B0248,
+    0xB6D2DB76, 0xC2C957A0, 0x5EE5C2DA, 0x2AFE4E0C, 0x12A764F8, 0x66BCE82E, 0xFA907D54, 0x8E8BF182,
+    0x939C1286, 0xE7879E50, 0x7BAB0B2A, 0x0FB087FC, 0x37E9AD08, 0x43F221DE, 0xDFDEB4A4, 0xABC53872,
+    0xAF6CE14C, 0xDB776D9A, 0x475BF8E0, 0x33407436, 0x0B195EC2, 0x7F02D214, 0xE32E476E, 0x9735CBB8,
+    0xEA7DF512, 0x9E6679C4, 0x024AECBE, 0x76516068, 0x4E084A9C, 0x3A13C64A, 0xA63F5330, 0xD224DFE6,
+    0xD68D06D8, 0xA2968A0E, 0x3EBA1F74, 0x4AA193A2, 0x72F8B956, 0x06E33580, 0x9ACFA0FA, 0xEED42C2C,
+    0x605FDDAE, 0x14445178, 0x8868C402, 0xFC7348D4, 0xC42A6220, 0xB031EEF6, 0x2C1D7B8C, 0x5806F75A,
+    0x5CAF2E64, 0x28B4A2B2, 0xB49837C8, 0xC083BB1E, 0xF8DA91EA, 0x8CC11D3C, 0x10ED8846, 0x64F60490,
+    0x19BE3A3A, 0x6DA5B6EC, 0xF1892396, 0x8592AF40, 0xBDCB85B4, 0xC9D00962, 0x55FC9C18, 0x21E710CE,
+    0x254EC9F0, 0x51554526, 0xCD79D05C, 0xB9625C8A, 0x813B767E, 0xF520FAA8, 0x690C6FD2, 0x1D17E304,
+    0x5323A9DA, 0x2738250C, 0xBB14B076, 0xCF0F3CA0, 0xF7561654, 0x834D9A82, 0x1F610FF8, 0x6B7A832E,
+    0x6FD35A10, 0x1BC8D6C6, 0x87E443BC, 0xF3FFCF6A, 0xCBA6E59E, 0xBFBD6948, 0x2391FC32, 0x578A70E4,
+    0x2AC24E4E, 0x5ED9C298, 0xC2F557E2, 0xB6EEDB34, 0x8EB7F1C0, 0xFAAC7D16, 0x6680E86C, 0x129B64BA,
+    0x1632BD84, 0x62293152, 0xFE05A428, 0x8A1E28FE, 0xB247020A, 0xC65C8EDC, 0x5A701BA6, 0x2E6B9770,
+    0xA0E066F2, 0xD4FBEA24, 0x48D77F5E, 0x3CCCF388, 0x0495D97C, 0x708E55AA, 0xECA2C0D0, 0x98B94C06,
+    0x9C109538, 0xE80B19EE, 0x74278C94, 0x003C0042, 0x38652AB6, 0x4C7EA660, 0xD052331A, 0xA449BFCC,
+    0xD9018166, 0xAD1A0DB0, 0x313698CA, 0x452D141C, 0x7D743EE8, 0x096FB23E, 0x95432744, 0xE158AB92,
+    0xE5F172AC, 0x91EAFE7A, 0x0DC66B00, 0x79DDE7D6, 0x4184CD22, 0x359F41F4, 0xA9B3D48E, 0xDDA85858,
+    0xC0BFBB5C, 0xB4A4378A, 0x2888A2F0, 0x5C932E26, 0x64CA04D2, 0x10D18804, 0x8CFD1D7E, 0xF8E691A8,
+    0xFC4F4896, 0x8854C440, 0x1478513A, 0x6063DDEC, 0x583AF718, 0x2C217BCE, 0xB00DEEB4, 0xC4166262,
+    0xB95E5CC8, 0xCD45D01E, 0x51694564, 0x2572C9B2, 0x1D2BE346, 0x69306F90, 0xF51CFAEA, 0x8107763C,
+    0x85AEAF02, 0xF1B523D4, 0x6D99B6AE, 0x19823A78, 0x21DB108C, 0x55C09C5A, 0xC9EC0920, 0xBDF785F6,
+    0x337C7474, 0x4767F8A2, 0xDB4B6DD8, 0xAF50E10E, 0x9709CBFA, 0xE312472C, 0x7F3ED256, 0x0B255E80,
+    0x0F8C87BE, 0x7B970B68, 0xE7BB9E12, 0x93A012C4, 0xABF93830, 0xDFE2B4E6, 0x43CE219C, 0x37D5AD4A,
+    0x4A9D93E0, 0x3E861F36, 0xA2AA8A4C, 0xD6B1069A, 0xEEE82C6E, 0x9AF3A0B8, 0x06DF35C2, 0x72C4B914,
+    0x766D602A, 0x0276ECFC, 0x9E5A7986, 0xEA41F550, 0xD218DFA4, 0xA6035372, 0x3A2FC608, 0x4E344ADE
+};
+
+/* x^k mod Q */
+inline uint64_t crc32XPower(size_t k)
+{
+    unsigned int r = 1;
+    for (size_t i = 0; i < k; i++)
+    {
+        r = (r << 1) ^ ((r >> 31) ? crcRem[1] : 0);
+    }
+    return r;
+}
+
+/* slice[s][v] = v * x^(32 + 8 * s) mod Q, slice[0] being crcRem; fold
+ * constants x^k mod Q for 128-bit and 512-bit folding steps */
+struct Crc32Tables
+{
+    unsigned int slice[16][256];
+    uint64_t fold128[2], fold512[2], x64;
+
+    Crc32Tables()
+    {
+        for (size_t v = 0; v < 256; v++)
+        {
+            slice[0][v] = crcRem[v];
+            for (size_t s = 1; s < 16; s++)
+            {
+                const unsigned int previous = slice[s - 1][v];
+                slice[s][v]                 = (previous << 8) ^ crcRem[previous >> 24];
+            }
+        }
+        fold128[0] = crc32XPower(128);
+        fold128[1] = crc32XPower(128 + 64);
+        fold512[0] = crc32XPower(512);
+        fold512[1] = crc32XPower(512 + 64);
+        x64        = crc32XPower(64);
+    }
+};
+
+inline const Crc32Tables &crc32Tables()
+{
+    static const Crc32Tables tables;
+    return tables;
+}
+
+/* the 4 bytes at p, p[3] the highest degree */
+inline unsigned int crc32Word(const unsigned char *p)
+{
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/* w * x^(32 + 8 * first) mod Q, a lookup per byte */
+inline unsigned int crc32Slices(const Crc32Tables &t, size_t first, unsigned int w)
+{
+    return t.slice[first][w & 0xFF] ^ t.slice[first + 1][(w >> 8) & 0xFF] ^ t.slice[first + 2][(w >> 16) & 0xFF] ^
+           t.slice[first + 3][w >> 24];
+}
+
+/* The remainder before the final correction, one byte at a time as
+ * getCRC32 always did: p[len - 1] down to p[0] appended to res */
+inline unsigned int crc32Bytewise(const unsigned char *p, size_t len, unsigned int res)
+{
+    while (len)
+    {
+        res = (res << 8) ^ p[--len] ^ crcRem[res >> 24];
+    }
+    return res;
+}
+
+/* 8 bytes per step: res * x^64 + w0 * x^32 + w1 mod Q, w0 the 4 bytes
+ * read first, with 8 independent lookups */
+inline unsigned int crc32Slicing8(const unsigned char *p, size_t len, unsigned int res)
+{
+    const Crc32Tables &t = crc32Tables();
+    while (len >= 8)
+    {
+        len -= 8;
+        res = crc32Slices(t, 4, res) ^ crc32Slices(t, 0, crc32Word(p + len + 4)) ^ crc32Word(p + len);
+    }
+    return crc32Bytewise(p, len, res);
+}
+
+/* 16 bytes per step, 16 independent lookups */
+inline unsigned int crc32Slicing16(const unsigned char *p, size_t len, unsigned int res)
+{
+    const Crc32Tables &t = crc32Tables();
+    while (len >= 16)
+    {
+        len -= 16;
+        res = crc32Slices(t, 12, res) ^ crc32Slices(t, 8, crc32Word(p + len + 12)) ^ crc32Slices(t, 4, crc32Word(p + len + 8)) ^
+              crc32Slices(t, 0, crc32Word(p + len + 4)) ^ crc32Word(p + len);
+    }
+    return crc32Slicing8(p, len, res);
+}
+
+#if CRC32_HAS_CLMUL
+inline bool crc32ClmulSupported()
+{
+    unsigned int eax, ebx, ecx, edx;
+    static const bool supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) && (edx & bit_SSE2);
+    return supported;
+}
+
+/* x * x^F + next mod Q in 128 bits, k = (x^F, x^(F + 64)) mod Q */
+__attribute__((target("pclmul,sse2"))) inline __m128i crc32Fold(__m128i x, __m128i k, __m128i next)
+{
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+}
+
+/* 64 bytes per step in four 128-bit accumulators: a 16-byte load below
+ * p + len holds the next bytes read with the first one at the top, so
+ * each is a polynomial of degree < 128 as loaded. The accumulators are
+ * folded into one, reduced to 64 bits by two carry-less products and to
+ * the remainder by four slices. Less than 64 bytes go to crc32Slicing16. */
+__attribute__((target("pclmul,sse2"))) inline unsigned int crc32Clmul(const unsigned char *p, size_t len, unsigned int res)
+{
+    if (len < 64)
+    {
+        return crc32Slicing16(p, len, res);
+    }
+    const Crc32Tables &t = crc32Tables();
+    const __m128i k128   = _mm_set_epi64x((long long)t.fold128[1], (long long)t.fold128[0]);
+    const __m128i k512   = _mm_set_epi64x((long long)t.fold512[1], (long long)t.fold512[0]);
+
+    /* res * x^(8 len) is res * x^128 mod Q added to the first 16 bytes */
+    len -= 64;
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + len + 48)), _mm_cvtsi32_si128((int)crc32Slices(t, 12, res)));
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(p + len + 32));
+    __m128i x2 = _mm_loadu_si128((const __m128i *)(p + len + 16));
+    __m128i x3 = _mm_loadu_si128((const __m128i *)(p + len));
+    while (len >= 64)
+    {
+        len -= 64;
+        x0 = crc32Fold(x0, k512, _mm_loadu_si128((const __m128i *)(p + len + 48)));
+        x1 = crc32Fold(x1, k512, _mm_loadu_si128((const __m128i *)(p + len + 32)));
+        x2 = crc32Fold(x2, k512, _mm_loadu_si128((const __m128i *)(p + len + 16)));
+        x3 = crc32Fold(x3, k512, _mm_loadu_si128((const __m128i *)(p + len)));
+    }
+    __m128i x = crc32Fold(crc32Fold(crc32Fold(x0, k128, x1), k128, x2), k128, x3);
+    while (len >= 16)
+    {
+        len -= 16;
+        x = crc32Fold(x, k128, _mm_loadu_si128((const __m128i *)(p + len)));
+    }
+
+    /* high * x^64 + low: high times x^64 mod Q leaves 96 bits, their top
+     * 32 times x^64 mod Q again 64 bits */
+    const __m128i k64 = _mm_set_epi64x(0, (long long)t.x64);
+    uint64_t a[2], b[2];
+    _mm_storeu_si128((__m128i *)a, _mm_xor_si128(_mm_clmulepi64_si128(x, k64, 0x01), _mm_move_epi64(x)));
+    _mm_storeu_si128((__m128i *)b, _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)a[1]), k64, 0x00));
+    const uint64_t y = a[0] ^ b[0];
+    res              = (unsigned int)y ^ crc32Slices(t, 0, (unsigned int)(y >> 32));
+    return crc32Slicing16(p, len, res);
+}
+#endif
+
+/* The remainder by the fastest path: folding from crc32ClmulMinimum
+ * bytes when the processor has PCLMULQDQ, slicing-by-16 otherwise */
+static const size_t crc32ClmulMinimum = 64;
+
+inline unsigned int crc32Remainder(const unsigned char *p, size_t len, unsigned int res)
+{
+#if CRC32_HAS_CLMUL
+    if (len >= crc32ClmulMinimum && crc32ClmulSupported())
+    {
+        return crc32Clmul(p, len, res);
+    }
+#endif
+    return crc32Slicing16(p, len, res);
+}
+
+/* the final correction of getCRC32 */
+inline unsigned int crc32Finish(unsigned int res)
+{
+    return res >= crcPoly ? res ^ crcPoly : res;
+}
+
+#endif
@@ -0,0 +1,676 @@
+/* file: csv.h */
+/*
+!  Content:
+!    Numeric CSV reader shared by the hand-written C++ examples
+!******************************************************************************/
+
+#ifndef _CSV_H
+#define _CSV_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <emmintrin.h>
+
+#include "error_handling.h"
+#include "parallel.h"
+
+/* A whole file mapped read-only, or read into a buffer when it cannot be
+ * mapped. Empty files give size() == 0. */
+class MappedFile
+{
+public:
+    MappedFile() : _data(NULL), _size(0), _mapped(false) {}
+
+    ~MappedFile() { close(); }
+
+    bool open(const char *fileName)
+    {
+        close();
+        int fd = ::open(fileName, O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        _size = st.st_size;
+
+        if (_size > 0)
+        {
+            void *p = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                madvise(p, _size, MADV_SEQUENTIAL);
+                _data   = (const char *)p;
+                _mapped = true;
+            }
+            else
+            {
+                char *buffer = new char[_size];
+                size_t done  = 0;
+                while (done < _size)
+                {
+                    ssize_t n = ::read(fd, buffer + done, _size - done);
+                    if (n <= 0)
+                    {
+                        break;
+                    }
+                    done += n;
+                }
+                _data = buffer;
+                _size = done;
+            }
+        }
+        ::close(fd);
+        return true;
+    }
+
+    void close()
+    {
+        if (_data && _mapped)
+        {
+            munmap((void *)_data, _size);
+        }
+        else if (_data)
+        {
+            delete[] _data;
+        }
+        _data   = NULL;
+        _size   = 0;
+        _mapped = false;
+    }
+
+    const char *data() const { return _data; }
+    const char *end() const { return _data + _size; }
+    size_t size() const { return _size; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const char *_data;
+    size_t _size;
+    bool _mapped;
+};
+
+/* Number of '\n' in [begin, end), 16 bytes per step */
+inline size_t countLines(const char *begin, const char *end)
+{
+    size_t n      = 0;
+    const char *p = begin;
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        n += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+    }
+    for (; p < end; p++)
+    {
+        n += *p == '\n';
+    }
+    return n;
+}
+
+/* Start of the line after the one holding p, or end */
+inline const char *nextLine(const char *p, const char *end)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), newline));
+        if (mask)
+        {
+            return p + __builtin_ctz(mask) + 1;
+        }
+    }
+    for (; p < end; p++)
+    {
+        if (*p == '\n')
+        {
+            return p + 1;
+        }
+    }
+    return end;
+}
+
+/* First field delimiter (',', ' ', '\t', '\r' or '\n') in [p, end), or
+ * end; 16 bytes per step */
+inline const char *findDelimiter(const char *p, const char *end)
+{
+    const __m128i comma   = _mm_set1_epi8(',');
+    const __m128i space   = _mm_set1_epi8(' ');
+    const __m128i tab     = _mm_set1_epi8('\t');
+    const __m128i cr      = _mm_set1_epi8('\r');
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        __m128i hits  = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, comma), _mm_cmpeq_epi8(block, space)),
+                                    _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, cr)),
+                                                 _mm_cmpeq_epi8(block, newline)));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    for (; p < end; p++)
+    {
+        if (*p == ',' || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+/* Position after word (lower case) if [p, end) starts with it in any
+ * case, or NULL */
+inline const char *matchWord(const char *p, const char *end, const char *word)
+{
+    for (; *word; word++, p++)
+    {
+        if (p == end || (*p | 0x20) != *word)
+        {
+            return NULL;
+        }
+    }
+    return p;
+}
+
+/* nan, nan(chars), inf and infinity in any case, as strtod reads them
+ * after the sign; returns the position after the word, or NULL */
+inline const char *parseNanOrInf(const char *p, const char *end, bool negative, double &value)
+{
+    const char *q = matchWord(p, end, "nan");
+    if (q)
+    {
+        if (q < end && *q == '(')
+        {
+            const char *r = q + 1;
+            while (r < end && ((unsigned)(*r - '0') < 10 || (unsigned)((*r | 0x20) - 'a') < 26 || *r == '_'))
+            {
+                r++;
+            }
+            if (r < end && *r == ')')
+            {
+                q = r + 1;
+            }
+        }
+        value = negative ? -std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::quiet_NaN();
+        return q;
+    }
+    q = matchWord(p, end, "inf");
+    if (q)
+    {
+        const char *r = matchWord(q, end, "inity");
+        value         = negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+        return r ? r : q;
+    }
+    return NULL;
+}
+
+/* Parses a decimal floating-point number at p. Values with up to 19
+ * digits and a power of ten within 10^+-22 are converted
+ * exactly with one multiplication or division (Clinger's fast path);
+ * anything else goes through strtod, so the result always matches
+ * strtod / std::stod. nan and inf tokens are read as strtod does (see
+ * parseNanOrInf); hexadecimal ones are not numbers here. Returns the
+ * position after the number, or NULL. */
+inline const char *parseDouble(const char *p, const char *end, double &value)
+{
+    static const double powers[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                     1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                     1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char *start = p;
+    bool negative     = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    if (p < end && ((*p | 0x20) == 'n' || (*p | 0x20) == 'i'))
+    {
+        return parseNanOrInf(p, end, negative, value);
+    }
+
+    /* digits accumulate unchecked; past 19 digits the mantissa may
+     * wrap, which only sends the token to the slow path */
+    unsigned long long mantissa = 0;
+    const char *firstDigit      = p;
+    while (p < end && (unsigned)(*p - '0') < 10)
+    {
+        mantissa = mantissa * 10 + (*p - '0');
+        p++;
+    }
+    size_t digits = p - firstDigit;
+    int exponent  = 0;
+    if (p < end && *p == '.')
+    {
+        const char *firstDecimal = ++p;
+        while (p < end && (unsigned)(*p - '0') < 10)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            p++;
+        }
+        digits += p - firstDecimal;
+        exponent = -(int)(p - firstDecimal);
+    }
+    if (digits == 0)
+    {
+        return NULL;
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *e = p + 1;
+        bool negativeExp = false;
+        if (e < end && (*e == '-' || *e == '+'))
+        {
+            negativeExp = *e == '-';
+            e++;
+        }
+        if (e < end && (unsigned)(*e - '0') < 10)
+        {
+            int exp10 = 0;
+            for (; e < end && (unsigned)(*e - '0') < 10; e++)
+            {
+                if (exp10 < 100000)
+                {
+                    exp10 = exp10 * 10 + (*e - '0');
+                }
+            }
+            exponent += negativeExp ? -exp10 : exp10;
+            p = e;
+        }
+    }
+
+    if (digits <= 19 && mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double v = (double)mantissa;
+        v        = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+        value    = negative ? -v : v;
+        return p;
+    }
+
+    /* slow path: strtod on a terminated copy of the token */
+    char token[64];
+    size_t length = p - start;
+    if (length >= sizeof(token))
+    {
+        std::vector<char> longToken(start, p);
+        longToken.push_back('\0');
+        value = strtod(&longToken[0], NULL);
+        return p;
+    }
+    memcpy(token, start, length);
+    token[length] = '\0';
+    value         = strtod(token, NULL);
+    return p;
+}
+
+inline const char *skipBlanks(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+/* Parses an unsigned decimal integer at p; returns the position after
+ * it, or NULL */
+inline const char *parseUnsigned(const char *p, const char *end, size_t &value)
+{
+    const char *first = p;
+    size_t v          = 0;
+    while (p < end && (unsigned)(*p - '0') < 10)
+    {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    value = v;
+    return p == first ? NULL : p;
+}
+
+inline const char *parseNumber(const char *p, const char *end, size_t &value)
+{
+    return parseUnsigned(p, end, value);
+}
+
+inline const char *parseNumber(const char *p, const char *end, double &value)
+{
+    return parseDouble(p, end, value);
+}
+
+template <typename T>
+inline const char *parseNumber(const char *p, const char *end, T &value)
+{
+    double v;
+    p     = parseDouble(p, end, v);
+    value = (T)v;
+    return p;
+}
+
+/* Reads the numbers of a text file line by line through a fixed-size
+ * buffer, so files of any size are read with bounded memory. Numbers
+ * are separated by commas and/or blanks; the end of each one is found
+ * by findDelimiter. */
+class CsvStream
+{
+public:
+    CsvStream(size_t bufferSize = 1 << 22) : _fd(-1), _buffer(std::max<size_t>(bufferSize, 4096)), _begin(0), _end(0), _eof(false) {}
+
+    ~CsvStream() { close(); }
+
+    bool open(const char *fileName)
+    {
+        close();
+        _fd = ::open(fileName, O_RDONLY);
+        return _fd >= 0;
+    }
+
+    void close()
+    {
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+        }
+        _fd    = -1;
+        _begin = _end = 0;
+        _eof          = false;
+    }
+
+    /* back to the first line */
+    void rewind()
+    {
+        lseek(_fd, 0, SEEK_SET);
+        _begin = _end = 0;
+        _eof          = false;
+    }
+
+    /* Next number of the current line: returns 1 and sets value, 0 at
+     * the end of the line (which is consumed) or of the file, -1 on a
+     * token that is not a number */
+    template <typename T>
+    int next(T &value)
+    {
+        for (;;)
+        {
+            while (_begin < _end && isSeparator(_buffer[_begin]))
+            {
+                _begin++;
+            }
+            if (_begin == _end)
+            {
+                if (!fill())
+                {
+                    return 0;
+                }
+                continue;
+            }
+            if (_buffer[_begin] == '\n')
+            {
+                _begin++;
+                return 0;
+            }
+
+            /* the token must end inside the buffer, unless the file does */
+            const char *token = &_buffer[_begin];
+            const char *end   = &_buffer[0] + _end;
+            const char *p     = findDelimiter(token, end);
+            if (p == end && !_eof && (_begin > 0 || _end < _buffer.size()))
+            {
+                fill();
+                continue;
+            }
+
+            const char *stop = parseNumber(token, p, value);
+            if (stop != p)
+            {
+                return -1;
+            }
+            _begin = p - &_buffer[0];
+            return 1;
+        }
+    }
+
+private:
+    CsvStream(const CsvStream &);
+    CsvStream &operator=(const CsvStream &);
+
+    static bool isSeparator(char c) { return c == ',' || c == ' ' || c == '\t' || c == '\r'; }
+
+    /* keeps the unread bytes and reads more after them */
+    bool fill()
+    {
+        if (_eof)
+        {
+            return false;
+        }
+        memmove(&_buffer[0], &_buffer[_begin], _end - _begin);
+        _end -= _begin;
+        _begin = 0;
+        ssize_t n = ::read(_fd, &_buffer[_end], _buffer.size() - _end);
+        if (n <= 0)
+        {
+            _eof = true;
+            return _end > 0;
+        }
+        _end += n;
+        return true;
+    }
+
+    int _fd;
+    std::vector<char> _buffer;
+    size_t _begin, _end;
+    bool _eof;
+};
+
+/* Number of fields of the first non-empty line, a trailing comma does
+ * not start a field */
+inline size_t countCsvColumns(const char *begin, const char *end)
+{
+    const char *p = begin;
+    while (p < end && (*p == '\n' || *p == '\r'))
+    {
+        p++;
+    }
+    if (p == end)
+    {
+        return 0;
+    }
+    size_t nCols = 1;
+    for (; p < end && *p != '\n' && *p != '\r'; p++)
+    {
+        if (*p == ',')
+        {
+            const char *q = skipBlanks(p + 1, end);
+            if (q < end && *q != '\n' && *q != '\r')
+            {
+                nCols++;
+            }
+        }
+    }
+    return nCols;
+}
+
+/* Parses the rows of [begin, end) into out, nCols values per row, and
+ * returns the number of rows. Empty lines are skipped; a trailing comma
+ * and '\r' before the newline are accepted. Returns (size_t)-1 if a row
+ * does not have exactly nCols numeric fields; errorLine gets its index
+ * within the range. */
+template <typename T>
+size_t parseCsvRows(const char *begin, const char *end, size_t nCols, T *out, size_t *errorLine = NULL)
+{
+    const char *p = begin;
+    size_t nRows = 0, line = 0;
+    while (p < end)
+    {
+        if (*p == '\n' || *p == '\r')
+        {
+            line += *p == '\n';
+            p++;
+            continue;
+        }
+
+        T *row = out + nRows * nCols;
+        for (size_t c = 0; c < nCols; c++)
+        {
+            double value;
+            p = skipBlanks(p, end);
+            const char *next = parseDouble(p, end, value);
+            if (!next)
+            {
+                if (errorLine)
+                {
+                    *errorLine = line;
+                }
+                return (size_t)-1;
+            }
+            row[c] = (T)value;
+            p      = skipBlanks(next, end);
+            if (c + 1 < nCols)
+            {
+                if (p == end || *p != ',')
+                {
+                    if (errorLine)
+                    {
+                        *errorLine = line;
+                    }
+                    return (size_t)-1;
+                }
+                p++;
+            }
+        }
+
+        /* optional trailing comma, then the end of the line */
+        if (p < end && *p == ',')
+        {
+            p = skipBlanks(p + 1, end);
+        }
+        if (p < end && *p == '\r')
+        {
+            p++;
+        }
+        if (p < end && *p != '\n')
+        {
+            if (errorLine)
+            {
+                *errorLine = line;
+            }
+            return (size_t)-1;
+        }
+        nRows++;
+    }
+    return nRows;
+}
+
+/* Smallest slice of a file worth parsing on its own thread */
+const size_t csvChunkBytes = 1 << 20;
+
+/* Reads a numeric CSV file into a contiguous row-major matrix and
+ * returns the number of rows; nCols gets the number of columns, taken
+ * from the first line. Every line must have that many numeric fields.
+ *
+ * The file is cut into one newline-aligned chunk per thread (nThreads,
+ * 0 = all cores; files under csvChunkBytes stay on one thread). Each
+ * chunk's lines are counted first, 16 bytes per step; a prefix sum of
+ * those counts gives every chunk its rows in the matrix, so the chunks
+ * are parsed concurrently straight into place and the row order is the
+ * file's. The parse is scalar: a field ends where parseDouble stops,
+ * so each byte is read once, without a separate delimiter scan. */
+template <typename T>
+size_t readCsv(const char *fileName, std::vector<T> &matrix, size_t &nCols, unsigned int nThreads = 0)
+{
+    MappedFile file;
+    if (!file.open(fileName))
+    {
+        fileOpenError(fileName);
+    }
+
+    nCols = countCsvColumns(file.data(), file.end());
+    if (nCols == 0)
+    {
+        matrix.clear();
+        return 0;
+    }
+
+    const char *begin = file.data();
+    const char *end   = file.end();
+    nThreads          = getNumberOfThreads(nThreads);
+    size_t nChunks    = std::min<size_t>(nThreads, file.size() / csvChunkBytes + 1);
+
+    /* chunk c is [bounds[c], bounds[c + 1]), each starts a line */
+    std::vector<const char *> bounds(nChunks + 1, end);
+    bounds[0] = begin;
+    for (size_t c = 1; c < nChunks; c++)
+    {
+        const char *cut = begin + c * (file.size() / nChunks);
+        bounds[c]       = std::max(bounds[c - 1], nextLine(cut - 1, end));
+    }
+
+    /* one row per line at most: firstLine[c] is where chunk c writes */
+    std::vector<size_t> firstLine(nChunks + 1, 0), nRows(nChunks, 0), errorLine(nChunks, 0);
+    parallelFor(nChunks, 1, nThreads, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; c++)
+        {
+            size_t lines = countLines(bounds[c], bounds[c + 1]);
+            if (bounds[c] < bounds[c + 1] && bounds[c + 1][-1] != '\n')
+            {
+                lines++;
+            }
+            firstLine[c + 1] = lines;
+        }
+    });
+    for (size_t c = 0; c < nChunks; c++)
+    {
+        firstLine[c + 1] += firstLine[c];
+    }
+    matrix.resize(firstLine[nChunks] * nCols);
+
+    T *out = matrix.empty() ? NULL : &matrix[0];
+    parallelFor(nChunks, 1, nThreads, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; c++)
+        {
+            nRows[c] = parseCsvRows(bounds[c], bounds[c + 1], nCols, out + firstLine[c] * nCols, &errorLine[c]);
+        }
+    });
+
+    /* stitch: empty lines leave gaps after a chunk's rows */
+    size_t rows = 0;
+    for (size_t c = 0; c < nChunks; c++)
+    {
+        if (nRows[c] == (size_t)-1)
+        {
+            std::cout << "'" << fileName << "' line " << firstLine[c] + errorLine[c] + 1 << ": expected " << nCols << " numeric fields"
+                      << std::endl;
+            sparceFileReadError();
+        }
+        if (rows != firstLine[c] && nRows[c])
+        {
+            memmove(out + rows * nCols, out + firstLine[c] * nCols, nRows[c] * nCols * sizeof(T));
+        }
+        rows += nRows[c];
+    }
+
+    matrix.resize(rows * nCols);
+    return rows;
+}
+
+#endif
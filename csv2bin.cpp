@@ -0,0 +1,172 @@
+// csv2bin.cpp : converts a numeric CSV file to a binary dataset file
+// (see dataset.h), the format the drivers map instead of parsing text
+//
+//  csv2bin input.csv output.bin [float|double] [rows|columns] [labels]
+//  csv2bin check
+//
+//  labels stores the last CSV column as the int32 label column; check
+//  compares the csv.h number parser with strtod and reads a file of
+//  nan / inf fields back
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "datagen.h"
+#include "dataset.h"
+
+// same value, or both nan with the same sign
+bool sameDouble(double a, double b)
+{
+	if (a != a || b != b)
+		return a != a && b != b && std::signbit(a) == std::signbit(b);
+	return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// whole token read by parseDouble, as strtod reads it
+bool parsesLikeStrtod(const std::string & token)
+{
+	const char * begin = token.c_str();
+	const char * end = begin + token.size();
+	double value = 0;
+	const char * stop = parseDouble(begin, end, value);
+	char * expectedStop;
+	double expected = strtod(begin, &expectedStop);
+	return stop == end && expectedStop == end && sameDouble(value, expected);
+}
+
+// token that is not a whole number for parseDouble
+bool rejected(const std::string & token)
+{
+	double value;
+	const char * stop = parseDouble(token.c_str(), token.c_str() + token.size(), value);
+	return stop != token.c_str() + token.size();
+}
+
+int check()
+{
+	const char * accepted[] = { "0", "-0", "+3", "1.5", ".5", "5.", "1E+5", "1e22", "1e23", "1e-22",
+				    "4.9e-324", "2.2250738585072014e-308", "1.7976931348623157e308", "1e400",
+				    "123456789012345678901234", "0.30000000000000004",
+				    "nan", "NaN", "-nan", "+NAN", "nan(123)", "nan(abc_1)", "inf", "-Inf", "+INF",
+				    "infinity", "-Infinity", "INFINITY",
+				    "3.14159265358979323846264338327950288419716939937510582097494459230781640628" };
+	const char * refused[] = { "", "-", "+", ".", "e5", "abc", "0x1p3", "in", "infin", "nan(", "nan(1", "1e", "1.5x" };
+
+	size_t failed = 0, total = 0;
+	for (size_t i = 0; i < sizeof(accepted) / sizeof(accepted[0]); i++, total++)
+		if (!parsesLikeStrtod(accepted[i]))
+		{
+			std::cout << "'" << accepted[i] << "' not read as strtod reads it" << std::endl;
+			failed++;
+		}
+	for (size_t i = 0; i < sizeof(refused) / sizeof(refused[0]); i++, total++)
+		if (!rejected(refused[i]))
+		{
+			std::cout << "'" << refused[i] << "' accepted" << std::endl;
+			failed++;
+		}
+
+	// random doubles of every magnitude, printed in full and short
+	for (uint64_t i = 0; i < 100000; i++, total++)
+	{
+		uint64_t bits = mixBits(i);
+		double v;
+		memcpy(&v, &bits, sizeof(v));
+		char text[64];
+		snprintf(text, sizeof(text), i & 1 ? "%.17g" : "%.6g", v);
+		if (!parsesLikeStrtod(text))
+		{
+			if (failed < 10)
+				std::cout << "'" << text << "' not read as strtod reads it" << std::endl;
+			failed++;
+		}
+	}
+
+	// nan and inf fields through readCsv and CsvStream
+	const char * fileName = "csv2bin_check.csv";
+	FILE * file = fopen(fileName, "w");
+	if (!file)
+	{
+		std::cout << "Unable to write file '" << fileName << "'" << std::endl;
+		return 1;
+	}
+	fputs("1,nan,-inf,\n2.5, Infinity ,-NaN\r\n", file);
+	fclose(file);
+	const double inf = std::numeric_limits<double>::infinity();
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	const double expected[] = { 1, nan, -inf, 2.5, inf, -nan };
+
+	std::vector<double> matrix;
+	size_t nCols = 0;
+	size_t nRows = readCsv(fileName, matrix, nCols);
+	bool same = nRows == 2 && nCols == 3;
+	for (size_t i = 0; same && i < 6; i++)
+		same = sameDouble(matrix[i], expected[i]);
+
+	CsvStream stream;
+	stream.open(fileName);
+	double value;
+	size_t n = 0;
+	for (int line = 0; line < 2; line++)
+		for (int r; (r = stream.next(value)) != 0; n++)
+			same = same && r == 1 && n < 6 && sameDouble(value, expected[n]);
+	same = same && n == 6;
+	remove(fileName);
+	total++;
+	if (!same)
+	{
+		std::cout << "nan / inf fields not read back" << std::endl;
+		failed++;
+	}
+
+	std::cout << "csv/parseDouble: " << total << " checks, " << failed << " failed " << (failed ? "FAILED" : "ok") << std::endl;
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc == 2 && strcmp(argv[1], "check") == 0)
+		return check();
+
+	if (argc < 3)
+	{
+		std::cout << "usage: csv2bin input.csv output.bin [float|double] [rows|columns] [labels]" << std::endl;
+		std::cout << "       csv2bin check" << std::endl;
+		return 1;
+	}
+
+	bool single = false, labels = false;
+	DatasetLayout layout = datasetRowMajor;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "float") == 0)
+			single = true;
+		else if (strcmp(argv[i], "double") == 0)
+			single = false;
+		else if (strcmp(argv[i], "columns") == 0)
+			layout = datasetColumnMajor;
+		else if (strcmp(argv[i], "rows") == 0)
+			layout = datasetRowMajor;
+		else if (strcmp(argv[i], "labels") == 0)
+			labels = true;
+	}
+
+	bool ok = single ?
+		convertCsvToDataset<float>(argv[1], argv[2], layout, labels) :
+		convertCsvToDataset<double>(argv[1], argv[2], layout, labels);
+	if (!ok)
+	{
+		std::cout << "Unable to write file '" << argv[2] << "'" << std::endl;
+		return 1;
+	}
+
+	Dataset dataset;
+	dataset.open(argv[2]);
+	std::cout << argv[2] << ": " << dataset.nRows() << " rows x " << dataset.nCols() << " columns"
+		<< (dataset.hasLabels() ? " + labels" : "") << std::endl;
+	return 0;
+}
@@ -0,0 +1,193 @@
+// datagen.cpp : writes reproducible synthetic data sets of any size for
+// the kmeans, adaboost and cholesky benchmarks
+//
+//  datagen kmeans   <N> <D> <K> [options]   N points of D values around
+//                                           K Gaussian centers
+//  datagen adaboost <N> <D> [options]       N samples of D features and a
+//                                           +1 / -1 label in the last column
+//  datagen cholesky <n> [options]           a symmetric positive definite
+//                                           n x n matrix
+//
+//  options:
+//   -o <file>     output CSV (default data/gen_kmeans.csv,
+//                 data/gen_adaboost.csv, data/cholesky_data.csv)
+//   -s <seed>     random seed (default 1)
+//   -t <threads>  threads (default all cores)
+//   -b            also write the binary dataset (dataset.h) that the
+//                 drivers map instead of the CSV, <file> with .bin
+//   -f <value>    kmeans: standard deviation of the blobs (default 10)
+//                 adaboost: distance between the class means, in noise
+//                 standard deviations (default 2; 0 = random labels)
+//
+// The output depends on the seed only, not on the number of threads:
+// every row draws from its own counter-based random stream.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "datagen.h"
+#include "dataset.h"
+
+using namespace std;
+
+// Appends v with 6 decimals
+static void appendValue(string & text, double v)
+{
+	char buffer[32];
+	if (!(fabs(v) < 9e12))
+	{
+		text.append(buffer, snprintf(buffer, sizeof(buffer), "%.17g", v));
+		return;
+	}
+
+	long long fixed = llround(fabs(v) * 1e6);
+	const bool negative = v < 0 && fixed != 0;
+	char * end = buffer + sizeof(buffer);
+	char * p = end;
+	for (int d = 0; d < 6; d++)
+	{
+		*--p = '0' + fixed % 10;
+		fixed /= 10;
+	}
+	*--p = '.';
+	do
+	{
+		*--p = '0' + fixed % 10;
+		fixed /= 10;
+	} while (fixed);
+	if (negative)
+		*--p = '-';
+	text.append(p, end - p);
+}
+
+// Writes nRows rows from make(row, values, label), in blocks generated
+// in parallel and written in order
+template <typename Rows>
+bool generate(const char * fileName, size_t nRows, size_t nCols, bool hasLabels, bool binary,
+	unsigned int nThreads, const Rows & make)
+{
+	FILE * csv = fopen(fileName, "w");
+	if (!csv)
+		return false;
+
+	DatasetWriter<double> writer;
+	string binName = datasetCacheName(fileName);
+	if (binary && !writer.open(binName.c_str(), nRows, nCols, hasLabels))
+	{
+		fclose(csv);
+		return false;
+	}
+
+	nThreads = getNumberOfThreads(nThreads);
+	const size_t blockRows = 4096;
+	const size_t roundRows = blockRows * nThreads * 4;
+	vector<double> values(min(roundRows, nRows) * nCols);
+	vector<int> labels(min(roundRows, nRows));
+	vector<string> text((min(roundRows, nRows) + blockRows - 1) / blockRows);
+
+	bool ok = true;
+	for (size_t first = 0; ok && first < nRows; first += roundRows)
+	{
+		const size_t n = min(roundRows, nRows - first);
+		const size_t nBlocks = (n + blockRows - 1) / blockRows;
+
+		parallelFor(nBlocks, 1, nThreads, [&](size_t b0, size_t b1) {
+			for (size_t b = b0; b < b1; b++)
+			{
+				string & t = text[b];
+				t.clear();
+				for (size_t i = b * blockRows; i < min(n, (b + 1) * blockRows); i++)
+				{
+					double * row = &values[i * nCols];
+					make(first + i, row, &labels[i]);
+					for (size_t j = 0; j < nCols; j++)
+					{
+						if (j)
+							t += ',';
+						appendValue(t, row[j]);
+					}
+					if (hasLabels)
+						t += labels[i] > 0 ? ",1" : ",-1";
+					t += '\n';
+				}
+			}
+		});
+
+		for (size_t b = 0; ok && b < nBlocks; b++)
+			ok = fwrite(text[b].data(), 1, text[b].size(), csv) == text[b].size();
+		if (ok && binary)
+			ok = writer.append(&values[0], n, hasLabels ? &labels[0] : NULL);
+	}
+
+	ok = fclose(csv) == 0 && ok;
+	return writer.close() && ok;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		cout << "usage: datagen kmeans <N> <D> <K> | adaboost <N> <D> | cholesky <n>"
+			<< " [-o file] [-s seed] [-t threads] [-b] [-f value]" << endl;
+		return 1;
+	}
+
+	const string kind = argv[1];
+	const int nSizes = kind == "kmeans" ? 3 : kind == "adaboost" ? 2 : 1;
+	if (argc < 2 + nSizes)
+	{
+		cout << "missing sizes for " << kind << endl;
+		return 1;
+	}
+	size_t sizes[3];
+	for (int i = 0; i < nSizes; i++)
+		sizes[i] = strtoull(argv[2 + i], NULL, 10);
+
+	string fileName = kind == "cholesky" ? "data/cholesky_data.csv" : "data/gen_" + kind + ".csv";
+	uint64_t seed = 1;
+	unsigned int nThreads = 0;
+	bool binary = false;
+	double factor = kind == "kmeans" ? 10.0 : 2.0;
+	for (int i = 2 + nSizes; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-b") == 0)
+			binary = true;
+		else if (i + 1 < argc && strcmp(argv[i], "-o") == 0)
+			fileName = argv[++i];
+		else if (i + 1 < argc && strcmp(argv[i], "-s") == 0)
+			seed = strtoull(argv[++i], NULL, 10);
+		else if (i + 1 < argc && strcmp(argv[i], "-t") == 0)
+			nThreads = atoi(argv[++i]);
+		else if (i + 1 < argc && strcmp(argv[i], "-f") == 0)
+			factor = atof(argv[++i]);
+	}
+
+	bool ok;
+	if (kind == "kmeans" && sizes[1] && sizes[2])
+		ok = generate(fileName.c_str(), sizes[0], sizes[1], false, binary, nThreads,
+			KMeansRows(sizes[1], sizes[2], factor, seed));
+	else if (kind == "adaboost" && sizes[1])
+		ok = generate(fileName.c_str(), sizes[0], sizes[1], true, binary, nThreads,
+			AdaBoostRows(sizes[1], factor, seed));
+	else if (kind == "cholesky")
+		ok = generate(fileName.c_str(), sizes[0], sizes[0], false, binary, nThreads,
+			CholeskyRows(sizes[0], seed));
+	else
+	{
+		cout << "unknown data set or empty size: " << kind << endl;
+		return 1;
+	}
+
+	if (!ok)
+	{
+		cout << "Unable to write file '" << fileName << "'" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,183 @@
+/* file: datagen.h */
+/*
+!  Content:
+!    Reproducible synthetic data sets for the kmeans, adaboost and cholesky
+!    examples, written to files by datagen.cpp or made in memory by the
+!    benchmark sweeps
+!******************************************************************************/
+
+#ifndef _DATAGEN_H
+#define _DATAGEN_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <stdint.h>
+
+#include "parallel.h"
+
+/* splitmix64 finalizer */
+inline uint64_t mixBits(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/* The random stream of one row: splitmix64 started from (seed, row), so
+ * that rows can be made in any order and on any thread */
+class RowRandom
+{
+public:
+    RowRandom(uint64_t seed, uint64_t row) : _state(mixBits(seed * 0x9E3779B97F4A7C15ULL + mixBits(row + 1))) {}
+
+    uint64_t next()
+    {
+        _state += 0x9E3779B97F4A7C15ULL;
+        return mixBits(_state);
+    }
+
+    /* [0, 1) */
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    /* N(0, 1), Box-Muller */
+    double gaussian()
+    {
+        double u1 = 1.0 - uniform();
+        double u2 = uniform();
+        return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+    }
+
+private:
+    uint64_t _state;
+};
+
+/* Gaussian blobs: each point belongs to a random center among K uniform
+ * in [-100, 100]^D, each value is the center's plus N(0, sigma) */
+struct KMeansRows
+{
+    size_t D;
+    std::vector<double> centers;
+    double sigma;
+    uint64_t seed;
+
+    KMeansRows(size_t D, size_t K, double sigma, uint64_t seed) : D(D), centers(K * D), sigma(sigma), seed(seed)
+    {
+        RowRandom random(seed, ~0ULL);
+        for (size_t i = 0; i < K * D; i++)
+        {
+            centers[i] = 200.0 * random.uniform() - 100.0;
+        }
+    }
+
+    template <typename T>
+    void operator()(size_t row, T *values, int *) const
+    {
+        RowRandom random(seed, row);
+        const double *center = &centers[(random.next() % (centers.size() / D)) * D];
+        for (size_t j = 0; j < D; j++)
+        {
+            values[j] = (T)(center[j] + sigma * random.gaussian());
+        }
+    }
+};
+
+/* Two classes: label +1 / -1, the class means at +/- separation / 2 along
+ * the diagonal, unit Gaussian noise. The Bayes accuracy is
+ * Phi(separation / 2), e.g. 84% for 2 and 98% for 4. */
+struct AdaBoostRows
+{
+    size_t D;
+    double shift;
+    uint64_t seed;
+
+    AdaBoostRows(size_t D, double separation, uint64_t seed) : D(D), shift(separation / (2.0 * sqrt((double)D))), seed(seed) {}
+
+    template <typename T>
+    void operator()(size_t row, T *values, int *label) const
+    {
+        RowRandom random(seed, row);
+        int y = (random.next() & 1) ? 1 : -1;
+        for (size_t j = 0; j < D; j++)
+        {
+            values[j] = (T)(y * shift + random.gaussian());
+        }
+        *label = y;
+    }
+};
+
+/* K classes: label uniform in [0, K), the class means drawn N(0, s^2) per
+ * value with s = separation / sqrt(2 D), so that two means are about
+ * separation apart, unit Gaussian noise */
+struct MultiClassRows
+{
+    size_t D;
+    std::vector<double> means;
+    uint64_t seed;
+
+    MultiClassRows(size_t D, size_t K, double separation, uint64_t seed) : D(D), means(K * D), seed(seed)
+    {
+        RowRandom random(seed, ~0ULL);
+        const double s = separation / sqrt(2.0 * (double)D);
+        for (size_t i = 0; i < K * D; i++)
+        {
+            means[i] = s * random.gaussian();
+        }
+    }
+
+    template <typename T>
+    void operator()(size_t row, T *values, int *label) const
+    {
+        RowRandom random(seed, row);
+        const size_t y = random.next() % (means.size() / D);
+        for (size_t j = 0; j < D; j++)
+        {
+            values[j] = (T)(means[y * D + j] + random.gaussian());
+        }
+        *label = (int)y;
+    }
+};
+
+/* Symmetric, entries in [-1, 1) off the diagonal and n on it: strictly
+ * diagonally dominant, hence positive definite. a(i, j) is drawn from
+ * (min(i, j), max(i, j)) so that any row can be made on its own. */
+struct CholeskyRows
+{
+    size_t n;
+    uint64_t seed;
+
+    CholeskyRows(size_t n, uint64_t seed) : n(n), seed(seed) {}
+
+    template <typename T>
+    void operator()(size_t row, T *values, int *) const
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            if (j == row)
+            {
+                values[j] = (T)n;
+                continue;
+            }
+            size_t a = row < j ? row : j, b = row < j ? j : row;
+            RowRandom random(seed, (uint64_t)a * n + b);
+            values[j] = (T)(2.0 * random.uniform() - 1.0);
+        }
+    }
+};
+
+/* Fills nRows x nCols values (row-major) and, when labels is not NULL,
+ * the labels of a generator in memory */
+template <typename T, typename Rows>
+void generateRows(const Rows &make, size_t nRows, size_t nCols, T *values, int *labels, unsigned int nThreads = 0)
+{
+    parallelFor(nRows, 1024, nThreads, [&](size_t begin, size_t end) {
+        int unused;
+        for (size_t i = begin; i < end; i++)
+        {
+            make(i, values + i * nCols, labels ? labels + i : &unused);
+        }
+    });
+}
+
+#endif
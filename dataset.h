@@ -0,0 +1,359 @@
+/* file: dataset.h */
+/*
+!  Content:
+!    Binary dataset files: a cache of the CSV inputs that is mapped and
+!    used in place
+!******************************************************************************/
+
+#ifndef _DATASET_H
+#define _DATASET_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "csv.h"
+
+/* Binary dataset file, version 1
+ *
+ *   header          64 bytes, DatasetHeader
+ *   values          at valuesOffset: nRows x nCols of dtype, either one
+ *                   row-major block or one block per column (column c
+ *                   at valuesOffset + c * columnStride)
+ *   labels          at labelsOffset if hasLabels: nRows int32
+ *
+ * Every block starts on a 64-byte boundary of the file, so a mapped
+ * file hands out aligned arrays. Native byte order, checked on open. */
+enum DatasetType
+{
+    datasetFloat  = 1,
+    datasetDouble = 2
+};
+
+enum DatasetLayout
+{
+    datasetRowMajor    = 0,
+    datasetColumnMajor = 1
+};
+
+struct DatasetHeader
+{
+    char magic[4]; /* "DMDS" */
+    uint32_t version;
+    uint32_t byteOrder; /* datasetByteOrder as written */
+    uint32_t dtype;     /* DatasetType */
+    uint32_t layout;    /* DatasetLayout */
+    uint32_t hasLabels;
+    uint64_t nRows;
+    uint64_t nCols;
+    uint64_t valuesOffset;
+    uint64_t columnStride; /* bytes between columns, column-major only */
+    uint64_t labelsOffset;
+};
+
+const char datasetMagic[4]      = { 'D', 'M', 'D', 'S' };
+const uint32_t datasetVersion   = 1;
+const uint32_t datasetByteOrder = 0x01020304;
+const size_t datasetAlignment   = 64;
+
+inline size_t alignDataset(size_t offset)
+{
+    return (offset + datasetAlignment - 1) / datasetAlignment * datasetAlignment;
+}
+
+template <typename T>
+struct DatasetTypeOf;
+template <>
+struct DatasetTypeOf<float>
+{
+    static const DatasetType value = datasetFloat;
+};
+template <>
+struct DatasetTypeOf<double>
+{
+    static const DatasetType value = datasetDouble;
+};
+
+/* Writes an nRows x nCols row-major matrix (and nRows labels, or NULL)
+ * as a binary dataset in the given layout. Returns false if the file
+ * cannot be written. */
+template <typename T>
+bool writeDataset(const char *fileName, const T *matrix, size_t nRows, size_t nCols, DatasetLayout layout, const int *labels)
+{
+    DatasetHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, datasetMagic, sizeof(header.magic));
+    header.version      = datasetVersion;
+    header.byteOrder    = datasetByteOrder;
+    header.dtype        = DatasetTypeOf<T>::value;
+    header.layout       = layout;
+    header.hasLabels    = labels != NULL;
+    header.nRows        = nRows;
+    header.nCols        = nCols;
+    header.valuesOffset = alignDataset(sizeof(DatasetHeader));
+    header.columnStride = layout == datasetColumnMajor ? alignDataset(nRows * sizeof(T)) : 0;
+
+    size_t valuesBytes  = layout == datasetColumnMajor ? nCols * header.columnStride : nRows * nCols * sizeof(T);
+    header.labelsOffset = labels ? alignDataset(header.valuesOffset + valuesBytes) : 0;
+
+    FILE *file = fopen(fileName, "wb");
+    if (!file)
+    {
+        return false;
+    }
+
+    static const char zeros[datasetAlignment] = { 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok      = ok && fwrite(zeros, 1, header.valuesOffset - sizeof(header), file) == header.valuesOffset - sizeof(header);
+
+    if (layout == datasetRowMajor)
+    {
+        ok = ok && fwrite(matrix, sizeof(T), nRows * nCols, file) == nRows * nCols;
+    }
+    else
+    {
+        std::vector<T> column(nRows);
+        size_t padding = header.columnStride - nRows * sizeof(T);
+        for (size_t c = 0; ok && c < nCols; c++)
+        {
+            for (size_t i = 0; i < nRows; i++)
+            {
+                column[i] = matrix[i * nCols + c];
+            }
+            ok = (nRows == 0 || fwrite(&column[0], sizeof(T), nRows, file) == nRows) && fwrite(zeros, 1, padding, file) == padding;
+        }
+    }
+
+    if (labels)
+    {
+        size_t padding = header.labelsOffset - header.valuesOffset - valuesBytes;
+        ok             = ok && fwrite(zeros, 1, padding, file) == padding;
+        for (size_t i = 0; ok && i < nRows; i++)
+        {
+            int32_t label = labels[i];
+            ok            = fwrite(&label, sizeof(label), 1, file) == 1;
+        }
+    }
+
+    return fclose(file) == 0 && ok;
+}
+
+/* Writes a row-major binary dataset a block of rows at a time, for data
+ * sets that are produced incrementally and need not fit in memory. The
+ * number of rows is fixed when the file is opened. */
+template <typename T>
+class DatasetWriter
+{
+public:
+    DatasetWriter() : _file(NULL), _rowsWritten(0) {}
+
+    ~DatasetWriter() { close(); }
+
+    bool open(const char *fileName, size_t nRows, size_t nCols, bool hasLabels)
+    {
+        close();
+        _rowsWritten = 0;
+        memset(&_header, 0, sizeof(_header));
+        memcpy(_header.magic, datasetMagic, sizeof(_header.magic));
+        _header.version      = datasetVersion;
+        _header.byteOrder    = datasetByteOrder;
+        _header.dtype        = DatasetTypeOf<T>::value;
+        _header.layout       = datasetRowMajor;
+        _header.hasLabels    = hasLabels;
+        _header.nRows        = nRows;
+        _header.nCols        = nCols;
+        _header.valuesOffset = alignDataset(sizeof(DatasetHeader));
+        _header.labelsOffset = hasLabels ? alignDataset(_header.valuesOffset + nRows * nCols * sizeof(T)) : 0;
+
+        _file = fopen(fileName, "wb");
+        if (!_file)
+        {
+            return false;
+        }
+        static const char zeros[datasetAlignment] = { 0 };
+        return fwrite(&_header, sizeof(_header), 1, _file) == 1
+               && fwrite(zeros, 1, _header.valuesOffset - sizeof(_header), _file) == _header.valuesOffset - sizeof(_header);
+    }
+
+    /* appends nRows rows (and their labels when the file has them) */
+    bool append(const T *rows, size_t nRows, const int *labels)
+    {
+        const size_t nValues = nRows * _header.nCols;
+        const size_t offset  = _header.valuesOffset + _rowsWritten * _header.nCols * sizeof(T);
+        bool ok              = fseek(_file, offset, SEEK_SET) == 0 && fwrite(rows, sizeof(T), nValues, _file) == nValues;
+        if (ok && _header.hasLabels && nRows)
+        {
+            std::vector<int32_t> block(labels, labels + nRows);
+            ok = fseek(_file, _header.labelsOffset + _rowsWritten * sizeof(int32_t), SEEK_SET) == 0
+                 && fwrite(&block[0], sizeof(int32_t), nRows, _file) == nRows;
+        }
+        _rowsWritten += nRows;
+        return ok;
+    }
+
+    /* false if fewer rows than announced were written or a write failed */
+    bool close()
+    {
+        if (!_file)
+        {
+            return true;
+        }
+        bool ok = fclose(_file) == 0 && _rowsWritten == _header.nRows;
+        _file   = NULL;
+        return ok;
+    }
+
+private:
+    DatasetWriter(const DatasetWriter &);
+    DatasetWriter &operator=(const DatasetWriter &);
+
+    FILE *_file;
+    DatasetHeader _header;
+    size_t _rowsWritten;
+};
+
+/* A binary dataset file mapped read-only. The arrays it hands out point
+ * into the mapping and live until close() or destruction. */
+class Dataset
+{
+public:
+    Dataset() : _header(NULL) {}
+
+    /* Returns false if the file is missing, not a version 1 dataset of
+     * this byte order, or truncated */
+    bool open(const char *fileName)
+    {
+        close();
+        if (!_file.open(fileName) || _file.size() < sizeof(DatasetHeader))
+        {
+            close();
+            return false;
+        }
+
+        const DatasetHeader *h = (const DatasetHeader *)_file.data();
+        size_t typeSize        = h->dtype == datasetDouble ? sizeof(double) : sizeof(float);
+        size_t valuesEnd = h->layout == datasetColumnMajor ? h->valuesOffset + h->nCols * h->columnStride
+                                                           : h->valuesOffset + h->nRows * h->nCols * typeSize;
+        if (memcmp(h->magic, datasetMagic, sizeof(h->magic)) != 0 || h->version != datasetVersion || h->byteOrder != datasetByteOrder
+            || (h->dtype != datasetFloat && h->dtype != datasetDouble) || h->layout > datasetColumnMajor || h->valuesOffset % datasetAlignment
+            || (h->layout == datasetColumnMajor && h->columnStride < h->nRows * typeSize) || valuesEnd > _file.size()
+            || (h->hasLabels && h->labelsOffset + h->nRows * sizeof(int32_t) > _file.size()))
+        {
+            close();
+            return false;
+        }
+        _header = h;
+        return true;
+    }
+
+    void close()
+    {
+        _file.close();
+        _header = NULL;
+    }
+
+    size_t nRows() const { return _header ? _header->nRows : 0; }
+    size_t nCols() const { return _header ? _header->nCols : 0; }
+    DatasetType type() const { return (DatasetType)(_header ? _header->dtype : 0); }
+    DatasetLayout layout() const { return (DatasetLayout)(_header ? _header->layout : 0); }
+    bool hasLabels() const { return _header && _header->hasLabels; }
+
+    /* The row-major nRows x nCols matrix, NULL for another dtype or a
+     * column-major file */
+    template <typename T>
+    const T *values() const
+    {
+        if (!_header || _header->dtype != DatasetTypeOf<T>::value || _header->layout != datasetRowMajor)
+        {
+            return NULL;
+        }
+        return (const T *)(_file.data() + _header->valuesOffset);
+    }
+
+    /* The nRows values of column c, NULL for another dtype or a row-major
+     * file */
+    template <typename T>
+    const T *column(size_t c) const
+    {
+        if (!_header || _header->dtype != DatasetTypeOf<T>::value || _header->layout != datasetColumnMajor || c >= _header->nCols)
+        {
+            return NULL;
+        }
+        return (const T *)(_file.data() + _header->valuesOffset + c * _header->columnStride);
+    }
+
+    const int32_t *labels() const { return hasLabels() ? (const int32_t *)(_file.data() + _header->labelsOffset) : NULL; }
+
+private:
+    Dataset(const Dataset &);
+    Dataset &operator=(const Dataset &);
+
+    MappedFile _file;
+    const DatasetHeader *_header;
+};
+
+/* Converts a numeric CSV file to a binary dataset. With labelColumn the
+ * last CSV column is stored as the (rounded) int32 label column. Exits
+ * through error_handling.h on a bad CSV; returns false if the output
+ * cannot be written. */
+template <typename T>
+bool convertCsvToDataset(const char *csvName, const char *datasetName, DatasetLayout layout, bool labelColumn, unsigned int nThreads = 0)
+{
+    std::vector<T> table;
+    size_t nCols;
+    size_t nRows = readCsv(csvName, table, nCols, nThreads);
+    if (!labelColumn)
+    {
+        return writeDataset(datasetName, table.empty() ? NULL : &table[0], nRows, nCols, layout, (const int *)NULL);
+    }
+
+    /* split off the last column */
+    size_t nFeatures = nCols ? nCols - 1 : 0;
+    std::vector<int> labels(nRows);
+    for (size_t i = 0; i < nRows; i++)
+    {
+        const T *row = &table[i * nCols];
+        labels[i]    = (int)floor(row[nFeatures] + 0.5);
+        memmove(&table[i * nFeatures], row, nFeatures * sizeof(T));
+    }
+    return writeDataset(datasetName, table.empty() ? NULL : &table[0], nRows, nFeatures, layout, labels.empty() ? NULL : &labels[0]);
+}
+
+/* Name of the binary cache of a CSV file: ".csv" replaced by ".bin" */
+inline std::string datasetCacheName(const char *csvName)
+{
+    std::string name(csvName);
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".csv") == 0)
+    {
+        name.resize(name.size() - 4);
+    }
+    return name + ".bin";
+}
+
+/* Maps the binary cache of a CSV file, converting the CSV first when the
+ * cache is missing, older than the CSV or stored differently. Returns
+ * false if the cache cannot be written; callers then read the CSV. */
+template <typename T>
+bool openDatasetCache(const char *csvName, Dataset &dataset, DatasetLayout layout, bool labelColumn, unsigned int nThreads = 0)
+{
+    std::string cacheName = datasetCacheName(csvName);
+
+    struct stat csvStat, cacheStat;
+    bool fresh = stat(cacheName.c_str(), &cacheStat) == 0 && (stat(csvName, &csvStat) != 0 || cacheStat.st_mtime >= csvStat.st_mtime);
+
+    if (fresh && dataset.open(cacheName.c_str()) && dataset.type() == DatasetTypeOf<T>::value && dataset.layout() == layout
+        && dataset.hasLabels() == labelColumn)
+    {
+        return true;
+    }
+
+    dataset.close();
+    return convertCsvToDataset<T>(csvName, cacheName.c_str(), layout, labelColumn, nThreads) && dataset.open(cacheName.c_str());
+}
+
+#endif
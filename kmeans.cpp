@@ -16,279 +16,111 @@
 #include <string>
 #include <time.h>
 
+#include "benchmark.h"
+#include "datagen.h"
+#include "dataset.h"
+#include "kmeans.h"
+#include "sweep.h"
+
 using namespace std;
 
-class Point
+// kmeans sweep [--n LIST] [--d LIST] [--k LIST] [--threads LIST]
+//              [--precision double,float] [--variant naive,optimized]
+//              [--iterations I] [--weak] [--out FILE]
+//
+//  K Gaussian blobs from datagen.h, made once per N, D, K and precision.
+//  naive is KMeans over Points (double, one thread), optimized is
+//  FlatKMeans.
+int kmeans_sweep(int argc, char *argv[], const BenchmarkOptions & options)
 {
-private:
-	int id_point, id_cluster;
+	SweepOptions sweep;
+	sweep.n.push_back(1000);
+	sweep.d.push_back(20);
+	sweep.k.push_back(20);
+	sweep.precisions.push_back("double");
+	sweep.precisions.push_back("float");
+	sweep.variants.push_back("naive");
+	sweep.variants.push_back("optimized");
+	parseSweepOptions(argc, argv, sweep);
+	int max_iterations = 5;
+	for (int i = 1; i + 1 < argc; i++)
+		if (strcmp(argv[i], "--iterations") == 0)
+			max_iterations = atoi(argv[i + 1]);
+
+	// the data of the last point
+	size_t data_n = 0, data_d = 0, data_k = 0;
+	string data_precision;
 	vector<double> values;
-	int total_values;
-	string name;
-
-public:
-	Point(int id_point, vector<double>& values, string name = "")
-	{
-		this->id_point = id_point;
-		total_values = values.size();
-
-		for (int i = 0; i < total_values; i++)
-			this->values.push_back(values[i]);
-
-		this->name = name;
-		id_cluster = -1;
-	}
-
-	int getID()
-	{
-		return id_point;
-	}
-
-	void setCluster(int id_cluster)
-	{
-		this->id_cluster = id_cluster;
-	}
-
-	int getCluster()
-	{
-		return id_cluster;
-	}
-
-	double getValue(int index)
-	{
-		return values[index];
-	}
-
-	int getTotalValues()
-	{
-		return total_values;
-	}
-
-	void addValue(double value)
-	{
-		values.push_back(value);
-	}
-
-	string getName()
-	{
-		return name;
-	}
-};
-
-class Cluster
-{
-private:
-	int id_cluster;
-	vector<double> central_values;
+	vector<float> values_float;
 	vector<Point> points;
 
-public:
-	Cluster(int id_cluster, Point point)
-	{
-		this->id_cluster = id_cluster;
-
-		int total_values = point.getTotalValues();
-
-		for (int i = 0; i < total_values; i++)
-			central_values.push_back(point.getValue(i));
-
-		points.push_back(point);
-	}
-
-	void addPoint(Point point)
-	{
-		points.push_back(point);
-	}
-
-	bool removePoint(int id_point)
-	{
-		int total_points = points.size();
-
-		for (int i = 0; i < total_points; i++)
-		{
-			if (points[i].getID() == id_point)
-			{
-				points.erase(points.begin() + i);
-				return true;
-			}
-		}
-		return false;
-	}
-
-	double getCentralValue(int index)
-	{
-		return central_values[index];
-	}
-
-	void setCentralValue(int index, double value)
-	{
-		central_values[index] = value;
-	}
-
-	Point getPoint(int index)
-	{
-		return points[index];
-	}
-
-	int getTotalPoints()
-	{
-		return points.size();
-	}
-
-	int getID()
-	{
-		return id_cluster;
-	}
-};
-
-class KMeans
-{
-private:
-	int K; // number of clusters
-	int total_values, total_points, max_iterations;
-	vector<Cluster> clusters;
-
-	// return ID of nearest center (uses euclidean distance)
-	int getIDNearestCenter(Point point)
-	{
-		double sum = 0.0, min_dist;
-		int id_cluster_center = 0;
+	runSweep("kmeans", sweep, options, [&](const SweepPoint & p, BenchmarkCase & c) -> bool {
+		const bool naive = p.variant == "naive";
+		if ((naive && (p.threads != 1 || p.precision != "double")) || (!naive && p.variant != "optimized")
+			|| (p.precision != "double" && p.precision != "float") || p.k > p.n)
+			return false;
 
-		for (int i = 0; i < total_values; i++)
+		if (p.n != data_n || p.d != data_d || p.k != data_k || p.precision != data_precision)
 		{
-			sum += pow(clusters[0].getCentralValue(i) -
-				point.getValue(i), 2.0);
+			data_n = p.n;
+			data_d = p.d;
+			data_k = p.k;
+			data_precision = p.precision;
+			values.resize(p.n * p.d);
+			generateRows(KMeansRows(p.d, p.k, 10.0, 1), p.n, p.d, &values[0], (int *)NULL);
+			values_float.assign(values.begin(), values.end());
+			points.clear();
 		}
-
-		min_dist = sqrt(sum);
-
-		for (int i = 1; i < K; i++)
-		{
-			double dist;
-			sum = 0.0;
-
-			for (int j = 0; j < total_values; j++)
+		if (naive && points.empty())
+			for (size_t i = 0; i < p.n; i++)
 			{
-				sum += pow(clusters[i].getCentralValue(j) -
-					point.getValue(j), 2.0);
+				vector<double> row(&values[i * p.d], &values[(i + 1) * p.d]);
+				points.push_back(Point(i, row));
 			}
 
-			dist = sqrt(sum);
-
-			if (dist < min_dist)
-			{
-				min_dist = dist;
-				id_cluster_center = i;
-			}
-		}
-
-		return id_cluster_center;
-	}
-
-public:
-	KMeans(int K, int total_points, int total_values, int max_iterations)
-	{
-		this->K = K;
-		this->total_points = total_points;
-		this->total_values = total_values;
-		this->max_iterations = max_iterations;
-	}
-
-	void run(vector<Point> & points)
-	{
-		if (K > total_points)
-			return;
-
-		vector<int> prohibited_indexes;
-
-		// choose K distinct values for the centers of the clusters
-		for (int i = 0; i < K; i++)
-		{
-			while (true)
-			{
-				int index_point = rand() % total_points;
-
-				if (find(prohibited_indexes.begin(), prohibited_indexes.end(),
-					index_point) == prohibited_indexes.end())
-				{
-					prohibited_indexes.push_back(index_point);
-					points[index_point].setCluster(i);
-					Cluster cluster(i, points[index_point]);
-					clusters.push_back(cluster);
-					break;
-				}
-			}
-		}
-
-		int iter = 1;
-
-		while (true)
-		{
-			bool done = true;
-
-			// associates each point to the nearest center
-			for (int i = 0; i < total_points; i++)
-			{
-				int id_old_cluster = points[i].getCluster();
-				int id_nearest_center = getIDNearestCenter(points[i]);
-
-				if (id_old_cluster != id_nearest_center)
-				{
-					if (id_old_cluster != -1)
-						clusters[id_old_cluster].removePoint(points[i].getID());
-
-					points[i].setCluster(id_nearest_center);
-					clusters[id_nearest_center].addPoint(points[i]);
-					done = false;
-				}
-			}
-
-			// recalculating the center of each cluster
-			for (int i = 0; i < K; i++)
-			{
-				for (int j = 0; j < total_values; j++)
-				{
-					int total_points_cluster = clusters[i].getTotalPoints();
-					double sum = 0.0;
-
-					if (total_points_cluster > 0)
-					{
-						for (int p = 0; p < total_points_cluster; p++)
-							sum += clusters[i].getPoint(p).getValue(j);
-						clusters[i].setCentralValue(j, sum / total_points_cluster);
-					}
-				}
-			}
-
-			if (done == true || iter >= max_iterations)
-			{
-				//cout << "Break in iteration " << iter << "\n\n";
-				break;
-			}
-
-			iter++;
-		}
-	}
-};
+		const int K = p.k, total_points = p.n, total_values = p.d;
+		const unsigned int threads = p.threads;
+		if (naive)
+			c.run = [&points, K, total_points, total_values, max_iterations]() {
+				KMeans kmeans(K, total_points, total_values, max_iterations);
+				kmeans.run(points);
+			};
+		else if (p.precision == "double")
+			c.run = [&values, K, total_points, total_values, max_iterations, threads]() {
+				FlatKMeans<double> kmeans(K, total_values, max_iterations, threads);
+				kmeans.run(&values[0], total_points, 1);
+			};
+		else
+			c.run = [&values_float, K, total_points, total_values, max_iterations, threads]() {
+				FlatKMeans<float> kmeans(K, total_values, max_iterations, threads);
+				kmeans.run(&values_float[0], total_points, 1);
+			};
+
+		const double N = p.n, D = p.d;
+		c.flopsPerRun = max_iterations * (N * K * D * 3 + N * D);
+		c.bytesPerRun = max_iterations * (N + K) * D * (p.precision == "double" ? sizeof(double) : sizeof(float));
+		return true;
+	});
+	return 0;
+}
 
 double randomDouble(double max) {
 	double r = static_cast <double> (rand()) / static_cast <double> (RAND_MAX);
 	return max * r;
 }
 
-uint64_t rdtsc() {
-	return __rdtsc();
-}
-
-
 int main(int argc, char *argv[])
 {
 	srand(time(NULL));
 
 	int total_points, total_values, K, max_iterations, has_name;
 
-	uint64_t uiInicio, uiFim;
-	int iTam = 1000;
+	// --warmup, --samples, --min-time, --filter, --json (benchmark.h)
+	BenchmarkOptions options;
+	parseBenchmarkOptions(argc, argv, options);
+
+	if (argc > 1 && strcmp(argv[1], "sweep") == 0)
+		return kmeans_sweep(argc, argv, options);
 
 	total_points = 1000;
 	total_values = 20;
@@ -299,23 +131,33 @@ int main(int argc, char *argv[])
 	vector<Point> points;
 	string point_name;
 	double max = 10;
-	vector<double> values;
 
-	ifstream file("data/kmeans_data.csv");
-	string value;
-	double value2;
-	int x = 0;
+	// one point per line, as many values as the file has columns,
+	// mapped from the binary cache data/kmeans_data.bin (written on
+	// the first run) or parsed on argv[1] threads (default all cores)
+	unsigned int nThreads = argc > 1 ? atoi(argv[1]) : 0;
+	Dataset dataset;
+	vector<double> table;
+	const double *matrix;
+	size_t nRows, nCols;
+	if (openDatasetCache<double>("data/kmeans_data.csv", dataset, datasetRowMajor, false, nThreads))
+	{
+		matrix = dataset.values<double>();
+		nRows = dataset.nRows();
+		nCols = dataset.nCols();
+	}
+	else
+	{
+		nRows = readCsv("data/kmeans_data.csv", table, nCols, nThreads);
+		matrix = table.empty() ? NULL : &table[0];
+	}
+	total_values = nCols;
+	if ((size_t)total_points > nRows)
+		total_points = nRows;
 
-	
 	for (int i = 0; i < total_points; i++)
 	{
-
-		for (int j = 0; j < total_values; j++)
-		{
-			getline(file, value, ',');
-			value2 = std::stod(value);
-			values.push_back(value2);
-		}
+		vector<double> values(matrix + i * nCols, matrix + (i + 1) * nCols);
 
 		if (has_name)
 		{
@@ -329,17 +171,15 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	clock_t tStart = clock();
-	uiInicio = rdtsc();
-	for (int number = 0; number<iTam; number++) {
+	// per iteration: 3 flops per value and center for the distances,
+	// one add per value for the new centers; the points and the centers
+	// are read once. Runs that converge early do less.
+	const double N = total_points, D = total_values;
+	registerBenchmark("kmeans/run", [&]() {
 		KMeans kmeans(K, total_points, total_values, max_iterations);
 		kmeans.run(points);
-	}
-
-	//Fim da medicao de tempo
-	uiFim = rdtsc();
+	}, total_points, max_iterations * (N * K * D * 3 + N * D), max_iterations * (N + K) * D * sizeof(double));
 
-	cout << (uiFim - uiInicio) / iTam << endl;
-	printf("\nTime taken: %.2fs\n", (double)(clock() - tStart) / (CLOCKS_PER_SEC*iTam));
+	runBenchmarks("kmeans", options);
 	return 0;
 }
@@ -0,0 +1,446 @@
+// kmeans.h : the hand-written k-means of kmeans.cpp, also compared
+// against DAAL by "kmeans_daal compare"
+//
+
+#ifndef _KMEANS_H
+#define _KMEANS_H
+
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <atomic>
+#include <mutex>
+
+#include "parallel.h"
+
+class Point
+{
+private:
+	int id_point, id_cluster;
+	std::vector<double> values;
+	int total_values;
+	std::string name;
+
+public:
+	Point(int id_point, std::vector<double>& values, std::string name = "")
+	{
+		this->id_point = id_point;
+		total_values = values.size();
+
+		for (int i = 0; i < total_values; i++)
+			this->values.push_back(values[i]);
+
+		this->name = name;
+		id_cluster = -1;
+	}
+
+	int getID()
+	{
+		return id_point;
+	}
+
+	void setCluster(int id_cluster)
+	{
+		this->id_cluster = id_cluster;
+	}
+
+	int getCluster()
+	{
+		return id_cluster;
+	}
+
+	double getValue(int index)
+	{
+		return values[index];
+	}
+
+	int getTotalValues()
+	{
+		return total_values;
+	}
+
+	void addValue(double value)
+	{
+		values.push_back(value);
+	}
+
+	std::string getName()
+	{
+		return name;
+	}
+};
+
+class Cluster
+{
+private:
+	int id_cluster;
+	std::vector<double> central_values;
+	std::vector<Point> points;
+
+public:
+	Cluster(int id_cluster, Point point)
+	{
+		this->id_cluster = id_cluster;
+
+		int total_values = point.getTotalValues();
+
+		for (int i = 0; i < total_values; i++)
+			central_values.push_back(point.getValue(i));
+
+		points.push_back(point);
+	}
+
+	void addPoint(Point point)
+	{
+		points.push_back(point);
+	}
+
+	bool removePoint(int id_point)
+	{
+		int total_points = points.size();
+
+		for (int i = 0; i < total_points; i++)
+		{
+			if (points[i].getID() == id_point)
+			{
+				points.erase(points.begin() + i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	double getCentralValue(int index)
+	{
+		return central_values[index];
+	}
+
+	void setCentralValue(int index, double value)
+	{
+		central_values[index] = value;
+	}
+
+	Point getPoint(int index)
+	{
+		return points[index];
+	}
+
+	int getTotalPoints()
+	{
+		return points.size();
+	}
+
+	int getID()
+	{
+		return id_cluster;
+	}
+};
+
+class KMeans
+{
+private:
+	int K; // number of clusters
+	int total_values, total_points, max_iterations;
+	std::vector<Cluster> clusters;
+
+	// return ID of nearest center (uses euclidean distance)
+	int getIDNearestCenter(Point point)
+	{
+		double sum = 0.0, min_dist;
+		int id_cluster_center = 0;
+
+		for (int i = 0; i < total_values; i++)
+		{
+			sum += pow(clusters[0].getCentralValue(i) -
+				point.getValue(i), 2.0);
+		}
+
+		min_dist = sqrt(sum);
+
+		for (int i = 1; i < K; i++)
+		{
+			double dist;
+			sum = 0.0;
+
+			for (int j = 0; j < total_values; j++)
+			{
+				sum += pow(clusters[i].getCentralValue(j) -
+					point.getValue(j), 2.0);
+			}
+
+			dist = sqrt(sum);
+
+			if (dist < min_dist)
+			{
+				min_dist = dist;
+				id_cluster_center = i;
+			}
+		}
+
+		return id_cluster_center;
+	}
+
+public:
+	KMeans(int K, int total_points, int total_values, int max_iterations)
+	{
+		this->K = K;
+		this->total_points = total_points;
+		this->total_values = total_values;
+		this->max_iterations = max_iterations;
+	}
+
+	double getCentralValue(int id_cluster, int index)
+	{
+		return clusters[id_cluster].getCentralValue(index);
+	}
+
+	// choose K distinct values for the centers of the clusters
+	void init(std::vector<Point> & points)
+	{
+		std::vector<int> prohibited_indexes;
+
+		clusters.clear();
+		for (int i = 0; i < K; i++)
+		{
+			while (true)
+			{
+				int index_point = rand() % total_points;
+
+				if (std::find(prohibited_indexes.begin(), prohibited_indexes.end(),
+					index_point) == prohibited_indexes.end())
+				{
+					prohibited_indexes.push_back(index_point);
+					points[index_point].setCluster(i);
+					Cluster cluster(i, points[index_point]);
+					clusters.push_back(cluster);
+					break;
+				}
+			}
+		}
+	}
+
+	// starts from given centers (K x total_values) instead of init, with
+	// empty clusters: the points must not belong to any yet
+	void setCenters(const double * centers)
+	{
+		clusters.clear();
+		for (int i = 0; i < K; i++)
+		{
+			std::vector<double> values(centers + i * total_values, centers + (i + 1) * total_values);
+			Cluster cluster(i, Point(-1, values));
+			cluster.removePoint(-1);
+			clusters.push_back(cluster);
+		}
+	}
+
+	// associates each point to the nearest center, true if none moved
+	bool assign(std::vector<Point> & points)
+	{
+		bool done = true;
+
+		for (int i = 0; i < total_points; i++)
+		{
+			int id_old_cluster = points[i].getCluster();
+			int id_nearest_center = getIDNearestCenter(points[i]);
+
+			if (id_old_cluster != id_nearest_center)
+			{
+				if (id_old_cluster != -1)
+					clusters[id_old_cluster].removePoint(points[i].getID());
+
+				points[i].setCluster(id_nearest_center);
+				clusters[id_nearest_center].addPoint(points[i]);
+				done = false;
+			}
+		}
+		return done;
+	}
+
+	// recalculating the center of each cluster
+	void update()
+	{
+		for (int i = 0; i < K; i++)
+		{
+			for (int j = 0; j < total_values; j++)
+			{
+				int total_points_cluster = clusters[i].getTotalPoints();
+				double sum = 0.0;
+
+				if (total_points_cluster > 0)
+				{
+					for (int p = 0; p < total_points_cluster; p++)
+						sum += clusters[i].getPoint(p).getValue(j);
+					clusters[i].setCentralValue(j, sum / total_points_cluster);
+				}
+			}
+		}
+	}
+
+	void run(std::vector<Point> & points)
+	{
+		if (K > total_points)
+			return;
+
+		init(points);
+
+		int iter = 1;
+
+		while (true)
+		{
+			bool done = assign(points);
+			update();
+
+			if (done == true || iter >= max_iterations)
+			{
+				//cout << "Break in iteration " << iter << "\n\n";
+				break;
+			}
+
+			iter++;
+		}
+	}
+};
+
+// The same algorithm as KMeans over a contiguous row-major matrix
+//
+//  No Point / Cluster copies: squared distances (no pow / sqrt) with the
+//  centers stored transposed so that the inner loop runs over the K
+//  centers and vectorizes, the points split across threads, per-thread
+//  sums for the new centers. Like KMeans::run, a center without points
+//  stays where it is and the loop stops when no point moved or after
+//  max_iterations.
+template <typename T>
+class FlatKMeans
+{
+private:
+	int K, total_values, max_iterations;
+	unsigned int num_threads;
+	std::vector<T> centers_t; // total_values x K
+
+public:
+	std::vector<int> assignment; // cluster of each point, -1 before the first pass
+	int iterations;
+
+	FlatKMeans(int K, int total_values, int max_iterations, unsigned int num_threads = 0) :
+		K(K), total_values(total_values), max_iterations(max_iterations), num_threads(num_threads),
+		centers_t(K * total_values), iterations(0)
+	{
+	}
+
+	T getCentralValue(int cluster, int index) const
+	{
+		return centers_t[index * K + cluster];
+	}
+
+	// centers: K x total_values
+	void setCenters(const T * centers)
+	{
+		for (int c = 0; c < K; c++)
+			for (int j = 0; j < total_values; j++)
+				centers_t[j * K + c] = centers[c * total_values + j];
+	}
+
+	// K distinct random points, rand_r(seed) like KMeans::run's rand()
+	void init(const T * points, int total_points, unsigned int seed)
+	{
+		std::vector<int> chosen;
+		while ((int)chosen.size() < K)
+		{
+			int index_point = rand_r(&seed) % total_points;
+			if (std::find(chosen.begin(), chosen.end(), index_point) == chosen.end())
+			{
+				for (int j = 0; j < total_values; j++)
+					centers_t[j * K + chosen.size()] = points[index_point * total_values + j];
+				chosen.push_back(index_point);
+			}
+		}
+	}
+
+	// associates each point to the nearest center, true if none moved
+	bool assign(const T * points, int total_points)
+	{
+		assignment.resize(total_points, -1);
+		std::atomic<bool> moved(false);
+		parallelFor(total_points, 256, num_threads, [&](size_t begin, size_t end) {
+			std::vector<T> dist(K);
+			bool block_moved = false;
+			for (size_t i = begin; i < end; i++)
+			{
+				const T * x = points + i * total_values;
+				std::fill(dist.begin(), dist.end(), T(0));
+				for (int j = 0; j < total_values; j++)
+				{
+					const T xj = x[j];
+					const T * c = &centers_t[j * K];
+					for (int k = 0; k < K; k++)
+					{
+						T d = xj - c[k];
+						dist[k] += d * d;
+					}
+				}
+				int nearest = 0;
+				for (int k = 1; k < K; k++)
+					if (dist[k] < dist[nearest])
+						nearest = k;
+				if (assignment[i] != nearest)
+				{
+					assignment[i] = nearest;
+					block_moved = true;
+				}
+			}
+			if (block_moved)
+				moved.store(true, std::memory_order_relaxed);
+		});
+		return !moved.load();
+	}
+
+	// recalculates the center of each cluster
+	void update(const T * points, int total_points)
+	{
+		std::vector<double> sums(K * total_values, 0.0);
+		std::vector<int> counts(K, 0);
+		std::mutex merge;
+		parallelFor(total_points, 1024, num_threads, [&](size_t begin, size_t end) {
+			std::vector<double> s(K * total_values, 0.0);
+			std::vector<int> n(K, 0);
+			for (size_t i = begin; i < end; i++)
+			{
+				const T * x = points + i * total_values;
+				double * sc = &s[assignment[i] * total_values];
+				for (int j = 0; j < total_values; j++)
+					sc[j] += x[j];
+				n[assignment[i]]++;
+			}
+			std::lock_guard<std::mutex> lock(merge);
+			for (int k = 0; k < K * total_values; k++)
+				sums[k] += s[k];
+			for (int k = 0; k < K; k++)
+				counts[k] += n[k];
+		});
+
+		for (int c = 0; c < K; c++)
+			if (counts[c] > 0)
+				for (int j = 0; j < total_values; j++)
+					centers_t[j * K + c] = (T)(sums[c * total_values + j] / counts[c]);
+	}
+
+	void run(const T * points, int total_points, unsigned int seed)
+	{
+		if (K > total_points)
+			return;
+
+		init(points, total_points, seed);
+		assignment.assign(total_points, -1);
+		for (iterations = 1; ; iterations++)
+		{
+			bool done = assign(points, total_points);
+			update(points, total_points);
+			if (done || iterations >= max_iterations)
+				break;
+		}
+	}
+};
+
+#endif
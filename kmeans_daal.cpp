@@ -2,8 +2,13 @@
 
 #include "daal.h"
 #include "service.h"
+#include "benchmark.h"
+#include "datagen.h"
+#include "kmeans.h"
+#include "sweep.h"
 //#include <intrin.h>
 #include <stdint.h>
+#include <map>
 
 
 using namespace std;
@@ -17,14 +22,473 @@ string datasetFileName     = "data/kmeans_data.csv";
 const size_t nClusters   = 20;
 const size_t nIterations = 5;
 
-uint64_t rdtsc() {
-	return __rdtsc();
+/* Random initial centers and nIterations Lloyd passes, as timed by main */
+template <typename T>
+void runKMeans(const NumericTablePtr &data, size_t clusters, size_t iterations)
+{
+    kmeans::init::Batch<T, kmeans::init::randomDense> init(clusters);
+    init.input.set(kmeans::init::data, data);
+    init.compute();
+
+    kmeans::Batch<T> algorithm(clusters, iterations);
+    algorithm.input.set(kmeans::data, data);
+    algorithm.input.set(kmeans::inputCentroids, init.getResult()->get(kmeans::init::centroids));
+    algorithm.compute();
+}
+
+/* kmeans_daal sweep [sweep.h options] [--iterations I]
+ *
+ * The rows of "kmeans sweep" for the daal variant: the same Gaussian
+ * blobs (datagen.h), the same flop and byte counts, DAAL limited to the
+ * threads of each point. */
+int kmeansSweep(int argc, char *argv[], const BenchmarkOptions &options)
+{
+    SweepOptions sweep;
+    sweep.n.push_back(1000);
+    sweep.d.push_back(20);
+    sweep.k.push_back(nClusters);
+    sweep.precisions.push_back("double");
+    sweep.precisions.push_back("float");
+    sweep.variants.push_back("daal");
+    parseSweepOptions(argc, argv, sweep);
+    size_t iterations = nIterations;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--iterations") == 0)
+        {
+            iterations = atoi(argv[i + 1]);
+        }
+    }
+
+    /* the data of the last point */
+    size_t dataN = 0, dataD = 0, dataK = 0;
+    vector<double> values;
+    vector<float> valuesFloat;
+    NumericTablePtr table, tableFloat;
+
+    runSweep("kmeans", sweep, options, [&](const SweepPoint &p, BenchmarkCase &c) -> bool {
+        if (p.variant != "daal" || (p.precision != "double" && p.precision != "float") || p.k > p.n)
+        {
+            return false;
+        }
+        if (p.n != dataN || p.d != dataD || p.k != dataK)
+        {
+            dataN = p.n;
+            dataD = p.d;
+            dataK = p.k;
+            values.resize(p.n * p.d);
+            generateRows(KMeansRows(p.d, p.k, 10.0, 1), p.n, p.d, &values[0], (int *)NULL);
+            valuesFloat.assign(values.begin(), values.end());
+            table      = NumericTablePtr(new HomogenNumericTable<double>(&values[0], p.d, p.n));
+            tableFloat = NumericTablePtr(new HomogenNumericTable<float>(&valuesFloat[0], p.d, p.n));
+        }
+        services::Environment::getInstance()->setNumberOfThreads(p.threads);
+
+        const size_t clusters = p.k;
+        if (p.precision == "double")
+        {
+            c.run = [&table, clusters, iterations]() { runKMeans<double>(table, clusters, iterations); };
+        }
+        else
+        {
+            c.run = [&tableFloat, clusters, iterations]() { runKMeans<float>(tableFloat, clusters, iterations); };
+        }
+
+        const double N = p.n, D = p.d;
+        c.flopsPerRun = iterations * (N * clusters * D * 3 + N * D);
+        c.bytesPerRun = iterations * (N + clusters) * D * (p.precision == "double" ? sizeof(double) : sizeof(float));
+        return true;
+    });
+    return 0;
+}
+
+/* Assignments and centroids of one implementation */
+struct Clustering
+{
+    vector<int> assignments;
+    vector<double> centroids; /* nClusters x nCols */
+};
+
+template <typename T>
+void readTable(const NumericTablePtr &table, vector<T> &values)
+{
+    const size_t nRows = table->getNumberOfRows();
+    const size_t nCols = table->getNumberOfColumns();
+    BlockDescriptor<T> block;
+    table->getBlockOfRows(0, nRows, readOnly, block);
+    const T *p = block.getBlockPtr();
+    values.assign(p, p + nRows * nCols);
+    table->releaseBlockOfRows(block);
+}
+
+/* The sum of the squared distances of the points to their centroids */
+double inertia(const vector<double> &points, size_t nRows, size_t nCols, const Clustering &c)
+{
+    double sum = 0;
+    for (size_t i = 0; i < nRows; i++)
+    {
+        const double *x = &points[i * nCols];
+        const double *m = &c.centroids[c.assignments[i] * nCols];
+        for (size_t j = 0; j < nCols; j++)
+        {
+            sum += (x[j] - m[j]) * (x[j] - m[j]);
+        }
+    }
+    return sum;
+}
+
+/* DAAL from the given centroids: no iteration only assigns the points */
+Clustering daalClustering(const NumericTablePtr &data, const NumericTablePtr &centroids, size_t clusters, size_t iterations)
+{
+    kmeans::Batch<double> algorithm(clusters, iterations);
+    algorithm.parameter.assignFlag = true;
+    algorithm.input.set(kmeans::data, data);
+    algorithm.input.set(kmeans::inputCentroids, centroids);
+    algorithm.compute();
+
+    Clustering c;
+    readTable(algorithm.getResult()->get(kmeans::assignments), c.assignments);
+    readTable(iterations ? algorithm.getResult()->get(kmeans::centroids) : centroids, c.centroids);
+    return c;
+}
+
+/* kmeans_daal compare [file] [--rows N] [--clusters K] [--iterations I]
+ *                    [--threads T] [--tolerance E] [--agreement A]
+ *
+ * The hand-written k-means of kmeans.h, naive (KMeans, one thread) and
+ * optimized (FlatKMeans<double>, T threads), against DAAL (T threads) on
+ * the same rows of the file and from the same initial centroids, the
+ * ones of kmeans::init::randomDense. Each phase is a benchmark case
+ * (benchmark.h options), its untimed setup resetting the state:
+ *
+ *   init       choosing the K initial centroids (randomDense,
+ *              KMeans::init, FlatKMeans::init)
+ *   assign     one pass associating each point to the nearest initial
+ *              centroid (DAAL: kmeans::Batch with no iteration)
+ *   iteration  one Lloyd iteration from the initial centroids, assign
+ *              and new centroids
+ *   run        I Lloyd iterations, without the early stop of
+ *              KMeans::run since DAAL does not stop before I either
+ *
+ * DAAL fuses the assign and update steps of an iteration, so the update
+ * time of all three is iteration - assign. The table gives each phase
+ * and the speedup of the hand-written code over DAAL (> 1: faster).
+ *
+ * The check compares the assignments after the assign pass and after
+ * the run with DAAL's: the fraction of points in the same cluster must
+ * be at least A (default 0.999, ties may go either way) and the inertia
+ * within a relative E (default 1e-6). A cluster that becomes empty keeps
+ * its centroid in kmeans.h but not in DAAL, which fails the check.
+ * Returns 1 when a check fails. */
+int kmeansCompare(int argc, char *argv[], const BenchmarkOptions &options)
+{
+    string fileName      = datasetFileName;
+    size_t rows          = 0;
+    size_t clusters      = nClusters;
+    size_t iterations    = nIterations;
+    unsigned int threads = 0;
+    double tolerance     = 1e-6;
+    double minAgreement  = 0.999;
+    for (int i = 2; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--rows") == 0)
+        {
+            rows = strtoull(argv[++i], NULL, 10);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--clusters") == 0)
+        {
+            clusters = strtoull(argv[++i], NULL, 10);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--iterations") == 0)
+        {
+            iterations = strtoull(argv[++i], NULL, 10);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--tolerance") == 0)
+        {
+            tolerance = atof(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--agreement") == 0)
+        {
+            minAgreement = atof(argv[++i]);
+        }
+        else
+        {
+            fileName = argv[i];
+        }
+    }
+    threads = getNumberOfThreads(threads);
+    services::Environment::getInstance()->setNumberOfThreads(threads);
+
+    /* the rows of the file, row-major, read by DAAL through a table on
+     * the same array */
+    FileDataSource<CSVFeatureManager> dataSource(fileName, DataSource::doAllocateNumericTable, DataSource::doDictionaryFromContext);
+    dataSource.loadDataBlock();
+    vector<double> values;
+    readTable(dataSource.getNumericTable(), values);
+    const size_t nCols = dataSource.getNumericTable()->getNumberOfColumns();
+    size_t nRows       = values.size() / max(nCols, (size_t)1);
+    if (rows && rows < nRows)
+    {
+        nRows = rows;
+        values.resize(nRows * nCols);
+    }
+    if (!nCols || clusters < 1 || clusters > nRows || !iterations)
+    {
+        cout << "need at least " << clusters << " rows, 1 cluster and 1 iteration" << endl;
+        return 1;
+    }
+    NumericTablePtr data(new HomogenNumericTable<double>(&values[0], nCols, nRows));
+
+    kmeans::init::Batch<double, kmeans::init::randomDense> init(clusters);
+    init.input.set(kmeans::init::data, data);
+    init.compute();
+    NumericTablePtr initialTable = init.getResult()->get(kmeans::init::centroids);
+    vector<double> initial;
+    readTable(initialTable, initial);
+
+    const int K = clusters, N = nRows, D = nCols, I = iterations;
+    vector<Point> points, work;
+    for (int i = 0; i < N; i++)
+    {
+        vector<double> row(&values[i * D], &values[(i + 1) * D]);
+        points.push_back(Point(i, row));
+    }
+    KMeans naive(K, N, D, I);
+    FlatKMeans<double> optimized(K, D, I, threads);
+
+    /* the same counts as kmeans/run for one pass */
+    const double assignFlops = (double)N * K * D * 3, updateFlops = (double)N * D;
+    const double bytes       = (double)(N + K) * D * sizeof(double);
+    const char *phases[]     = { "init", "assign", "iteration", "run" };
+    const double flops[]     = { 0, assignFlops, assignFlops + updateFlops, I * (assignFlops + updateFlops) };
+    const double passes[]    = { 0, 1, 1, (double)I };
+    for (int phase = 0; phase < 4; phase++)
+    {
+        const int runs = phase == 3 ? I : 1;
+        BenchmarkCase c;
+        c.itemsPerRun = N;
+        c.flopsPerRun = flops[phase];
+        c.bytesPerRun = passes[phase] * bytes;
+
+        c.name  = string("compare/daal/") + phases[phase];
+        c.setup = std::function<void()>();
+        if (phase == 0)
+        {
+            c.run = [&data, clusters]() {
+                kmeans::init::Batch<double, kmeans::init::randomDense> init(clusters);
+                init.input.set(kmeans::init::data, data);
+                init.compute();
+            };
+        }
+        else
+        {
+            c.run = [&data, &initialTable, clusters, runs, phase]() {
+                kmeans::Batch<double> algorithm(clusters, phase == 1 ? 0 : runs);
+                algorithm.parameter.assignFlag = phase == 1;
+                algorithm.input.set(kmeans::data, data);
+                algorithm.input.set(kmeans::inputCentroids, initialTable);
+                algorithm.compute();
+            };
+        }
+        benchmarkRegistry().push_back(c);
+
+        c.name = string("compare/naive/") + phases[phase];
+        if (phase == 0)
+        {
+            c.setup = [&work, &points]() { work = points; };
+            c.run   = [&naive, &work]() { naive.init(work); };
+        }
+        else
+        {
+            c.setup = [&naive, &work, &points, &initial]() {
+                work = points;
+                naive.setCenters(&initial[0]);
+            };
+            c.run = [&naive, &work, runs, phase]() {
+                for (int i = 0; i < runs; i++)
+                {
+                    naive.assign(work);
+                    if (phase > 1)
+                    {
+                        naive.update();
+                    }
+                }
+            };
+        }
+        benchmarkRegistry().push_back(c);
+
+        c.name = string("compare/optimized/") + phases[phase];
+        if (phase == 0)
+        {
+            c.setup = std::function<void()>();
+            c.run   = [&optimized, &values, N]() { optimized.init(&values[0], N, 1); };
+        }
+        else
+        {
+            c.setup = [&optimized, &initial, N]() {
+                optimized.setCenters(&initial[0]);
+                optimized.assignment.assign(N, -1);
+            };
+            c.run = [&optimized, &values, N, runs, phase]() {
+                for (int i = 0; i < runs; i++)
+                {
+                    optimized.assign(&values[0], N);
+                    if (phase > 1)
+                    {
+                        optimized.update(&values[0], N);
+                    }
+                }
+            };
+        }
+        benchmarkRegistry().push_back(c);
+    }
+
+    vector<BenchmarkResult> results = runBenchmarks("kmeans_daal compare", options);
+    map<string, double> seconds;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        seconds[results[i].name] = results[i].seconds.median;
+    }
+
+    /* median seconds per phase, update derived */
+    const char *implementations[] = { "daal", "naive", "optimized" };
+    const char *rowNames[]        = { "init", "assign", "update", "iteration", "run" };
+    printf("\n%-10s %12s %12s %12s %14s %14s\n", "phase", "daal s", "naive s", "optimized s", "naive/daal", "optimized/daal");
+    for (int row = 0; row < 5; row++)
+    {
+        double t[3];
+        for (int impl = 0; impl < 3; impl++)
+        {
+            const string prefix = string("compare/") + implementations[impl] + "/";
+            if (row == 2)
+            {
+                const bool known = seconds.count(prefix + "iteration") && seconds.count(prefix + "assign");
+                t[impl]          = known ? max(seconds[prefix + "iteration"] - seconds[prefix + "assign"], 0.0) : -1;
+            }
+            else
+            {
+                t[impl] = seconds.count(prefix + rowNames[row]) ? seconds[prefix + rowNames[row]] : -1;
+            }
+        }
+        printf("%-10s", rowNames[row]);
+        for (int impl = 0; impl < 3; impl++)
+        {
+            if (t[impl] >= 0)
+            {
+                printf(" %12.6g", t[impl]);
+            }
+            else
+            {
+                printf(" %12s", "-");
+            }
+        }
+        for (int impl = 1; impl < 3; impl++)
+        {
+            if (t[0] > 0 && t[impl] > 0)
+            {
+                printf(" %13.3gx", t[0] / t[impl]);
+            }
+            else
+            {
+                printf(" %14s", "-");
+            }
+        }
+        printf("\n");
+    }
+
+    /* the check, untimed */
+    bool ok = true;
+    printf("\n%-18s %10s %16s %16s %12s\n", "check", "agreement", "inertia", "daal inertia", "relative");
+    for (int check = 0; check < 2; check++)
+    {
+        const int runs = check ? I : 0;
+        Clustering reference = daalClustering(data, initialTable, clusters, runs);
+        const double referenceInertia = inertia(values, N, D, reference);
+
+        for (int impl = 1; impl < 3; impl++)
+        {
+            /* the assignments to the centroids of the last update */
+            Clustering c;
+            c.centroids.resize(K * D);
+            if (impl == 1)
+            {
+                work = points;
+                naive.setCenters(&initial[0]);
+                for (int i = 0; i < runs; i++)
+                {
+                    naive.assign(work);
+                    naive.update();
+                }
+                naive.assign(work);
+                for (int i = 0; i < N; i++)
+                {
+                    c.assignments.push_back(work[i].getCluster());
+                }
+                for (int k = 0; k < K; k++)
+                {
+                    for (int j = 0; j < D; j++)
+                    {
+                        c.centroids[k * D + j] = naive.getCentralValue(k, j);
+                    }
+                }
+            }
+            else
+            {
+                optimized.setCenters(&initial[0]);
+                optimized.assignment.assign(N, -1);
+                for (int i = 0; i < runs; i++)
+                {
+                    optimized.assign(&values[0], N);
+                    optimized.update(&values[0], N);
+                }
+                optimized.assign(&values[0], N);
+                c.assignments = optimized.assignment;
+                for (int k = 0; k < K; k++)
+                {
+                    for (int j = 0; j < D; j++)
+                    {
+                        c.centroids[k * D + j] = optimized.getCentralValue(k, j);
+                    }
+                }
+            }
+
+            size_t same = 0;
+            for (int i = 0; i < N; i++)
+            {
+                same += c.assignments[i] == reference.assignments[i];
+            }
+            const double agreement = (double)same / N;
+            const double cInertia  = inertia(values, N, D, c);
+            const double relative  = fabs(cInertia - referenceInertia) / max(referenceInertia, 1e-300);
+            const bool passed      = agreement >= minAgreement && relative <= tolerance;
+            ok                     = ok && passed;
+
+            const string name = string(check ? "run/" : "assign/") + implementations[impl];
+            printf("%-18s %10.6f %16.10g %16.10g %12.3g %s\n", name.c_str(), agreement, cInertia, referenceInertia, relative,
+                   passed ? "ok" : "FAILED");
+        }
+    }
+    return ok ? 0 : 1;
 }
 
 int main(int argc, char *argv[])
 {
-	uint64_t uiInicio, uiFim;
-	int iTam = 1000;
+    /* --warmup, --samples, --min-time, --filter, --json (benchmark.h) */
+    BenchmarkOptions options;
+    parseBenchmarkOptions(argc, argv, options);
+
+    if (argc > 1 && strcmp(argv[1], "sweep") == 0)
+    {
+        return kmeansSweep(argc, argv, options);
+    }
+    if (argc > 1 && strcmp(argv[1], "compare") == 0)
+    {
+        return kmeansCompare(argc, argv, options);
+    }
 
     checkArguments(argc, argv, 1, &datasetFileName);
 
@@ -35,9 +499,11 @@ int main(int argc, char *argv[])
     /* Retrieve the data from the input file */
     dataSource.loadDataBlock();
 
-	uiInicio = rdtsc();
-
-	for (int i = 0; i < iTam; i++) {
+	/* same counts as kmeans/run: 3 flops per value and center for the
+	 * distances, one add per value for the new centers */
+	const double N = dataSource.getNumericTable()->getNumberOfRows();
+	const double D = dataSource.getNumericTable()->getNumberOfColumns();
+	registerBenchmark("kmeans_daal/init_run", [&]() {
 		/* Get initial clusters for the K-Means algorithm */
 		kmeans::init::Batch<double, kmeans::init::randomDense> init(nClusters);
 
@@ -54,12 +520,9 @@ int main(int argc, char *argv[])
 		algorithm.input.set(kmeans::inputCentroids, centroids);
 
 		algorithm.compute();
-		}
-
-	//Fim da medicao de tempo
-	uiFim = rdtsc();
+	}, N, nIterations * (N * nClusters * D * 3 + N * D), nIterations * (N + nClusters) * D * sizeof(double));
 
-	cout << (uiFim - uiInicio) / iTam << endl;
+	runBenchmarks("kmeans_daal", options);
 
     ///* Print the clusterization results */
     //printNumericTable(algorithm.getResult()->get(kmeans::assignments), "First 10 cluster assignments:", 10);
@@ -0,0 +1,176 @@
+/* file: parallel.h */
+/*
+!  Content:
+!    Minimal std::thread helpers used by the hand-written C++ examples
+!******************************************************************************/
+
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Number of threads to use when the caller passes 0 ("all cores") */
+inline unsigned int getNumberOfThreads(unsigned int requested = 0)
+{
+    if (requested)
+    {
+        return requested;
+    }
+    unsigned int n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+/* Splits [0, n) into at most nThreads contiguous ranges of at least grain
+ * items each and calls body(begin, end) once per range. The calling thread
+ * runs the first range, so small inputs never spawn a thread. */
+template <typename Body>
+void parallelFor(size_t n, size_t grain, unsigned int nThreads, Body body)
+{
+    if (n == 0)
+    {
+        return;
+    }
+    if (grain == 0)
+    {
+        grain = 1;
+    }
+
+    size_t nChunks = std::min<size_t>(getNumberOfThreads(nThreads), (n + grain - 1) / grain);
+    if (nChunks <= 1)
+    {
+        body(size_t(0), n);
+        return;
+    }
+
+    const size_t chunk = n / nChunks;
+    const size_t rest  = n % nChunks;
+
+    std::vector<std::thread> workers;
+    workers.reserve(nChunks - 1);
+
+    size_t begin = chunk + (rest ? 1 : 0);
+    for (size_t c = 1; c < nChunks; c++)
+    {
+        size_t end = begin + chunk + (c < rest ? 1 : 0);
+        workers.push_back(std::thread(body, begin, end));
+        begin = end;
+    }
+
+    body(size_t(0), chunk + (rest ? 1 : 0));
+
+    for (size_t c = 0; c < workers.size(); c++)
+    {
+        workers[c].join();
+    }
+}
+
+/* The per-thread task deques of runTasks. A thread pushes and pops its
+ * newest tasks at the back, thieves take the oldest at the front, so a
+ * thread keeps working on what it just made ready while the others
+ * pick up the tasks that have waited longest. */
+template <typename Task>
+class TaskQueues
+{
+public:
+    explicit TaskQueues(unsigned int nThreads) : _queues(nThreads), _pending(0) {}
+
+    void push(unsigned int thread, const Task &task)
+    {
+        _pending.fetch_add(1);
+        std::lock_guard<std::mutex> lock(_queues[thread].lock);
+        _queues[thread].tasks.push_back(task);
+    }
+
+    /* the newest task of this thread, or else the oldest of another */
+    bool take(unsigned int thread, Task &task)
+    {
+        for (size_t i = 0; i < _queues.size(); i++)
+        {
+            Queue &q = _queues[(thread + i) % _queues.size()];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if (!q.tasks.empty())
+            {
+                if (i == 0)
+                {
+                    task = q.tasks.back();
+                    q.tasks.pop_back();
+                }
+                else
+                {
+                    task = q.tasks.front();
+                    q.tasks.pop_front();
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* after a taken task has run and pushed the tasks it made ready */
+    void done() { _pending.fetch_sub(1); }
+
+    bool finished() const { return _pending.load() == 0; }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        char padding[64]; /* no false sharing between the locks */
+    };
+
+    std::vector<Queue> _queues;
+    std::atomic<size_t> _pending; /* queued or running */
+};
+
+/* Runs a dynamic task graph on nThreads threads (the caller and
+ * nThreads - 1 new ones) with work stealing. execute(task, spawn) runs
+ * one task and calls spawn(next) for each task it makes ready; returns
+ * when every task has run. Tasks are small values (indices), copied. */
+template <typename Task, typename Execute>
+void runTasks(const std::vector<Task> &initial, unsigned int nThreads, Execute execute)
+{
+    nThreads = getNumberOfThreads(nThreads);
+    TaskQueues<Task> queues(nThreads);
+    for (size_t i = 0; i < initial.size(); i++)
+    {
+        queues.push((unsigned int)(i % nThreads), initial[i]);
+    }
+
+    auto worker = [&](unsigned int thread) {
+        auto spawn = [&](const Task &next) { queues.push(thread, next); };
+        Task task;
+        while (!queues.finished())
+        {
+            if (queues.take(thread, task))
+            {
+                execute(task, spawn);
+                queues.done();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(nThreads - 1);
+    for (unsigned int t = 1; t < nThreads; t++)
+    {
+        workers.push_back(std::thread(worker, t));
+    }
+    worker(0);
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+}
+
+#endif
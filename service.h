@@ -38,6 +38,8 @@ using namespace daal::data_management;
 #include <queue>
 
 #include "error_handling.h"
+#include "csv.h"
+#include "crc32.h"
 
 size_t readTextFile(const std::string &datasetFileName, daal::byte **data)
 {
@@ -64,92 +66,134 @@ size_t readTextFile(const std::string &datasetFileName, daal::byte **data)
     return fileSize;
 }
 
+/* Parses the comma and/or blank separated numbers of a line into data */
 template <typename item_type>
 void readRowUnknownLength(char* line, std::vector<item_type>& data)
 {
-    size_t n = 0;
-    const char* prevDelim = line - 1;
-    char* ptr = line;
-    for(; *ptr; ++ptr)
+    data.clear();
+    const char* end = line + strlen(line);
+    const char* p   = line;
+    for (;;)
     {
-        if(*ptr == ',' || *ptr == '\r')
+        while (p < end && (*p == ',' || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
         {
-            if(prevDelim != ptr - 1)
-                ++n;
-            *ptr = ' ';
-            prevDelim = ptr;
+            ++p;
         }
-    }
-    if(prevDelim != ptr - 1)
-        ++n;
-    data.resize(n);
-    std::stringstream iss(line);
-    for(size_t i = 0; i < n; ++i)
-    {
-        iss >> data[i];
+        if (p == end)
+        {
+            break;
+        }
+        item_type value;
+        const char* next = parseNumber(p, end, value);
+        if (!next)
+        {
+            sparceFileReadError();
+        }
+        data.push_back(value);
+        p = next;
     }
 }
 
+/* Reads a CSR file: 1-based row offsets, column indices and values, one
+ * line each. The file is streamed through a fixed-size buffer and every
+ * number is parsed straight into the arrays of the table. The row
+ * offsets line is read twice: first to count the rows and take the last
+ * offset (the number of non-zeros + 1) so that the table can be
+ * allocated, then into the table. */
 template <typename item_type>
 CSRNumericTable *createSparseTable(const std::string& datasetFileName)
 {
-    std::ifstream file(datasetFileName .c_str());
-
-    if (!file.is_open())
+    CsvStream stream;
+    if (!stream.open(datasetFileName .c_str()))
     {
         fileOpenError(datasetFileName .c_str());
     }
 
-    std::string str;
-
-    //read row offsets
-    std::getline(file, str);
-    std::vector<size_t> rowOffsets;
-    readRowUnknownLength<size_t>(&str[0], rowOffsets);
-    if(!rowOffsets.size())
-        return NULL;
-    const size_t nVectors = rowOffsets.size() - 1;
-
-    //read cols indices
-    std::getline(file, str);
-    std::vector<size_t> colIndices;
-    readRowUnknownLength<size_t>(&str[0], colIndices);
-
-    //read values
-    std::getline(file, str);
-    std::vector<item_type> data;
-    readRowUnknownLength<item_type>(&str[0], data);
-    const size_t nNonZeros = data.size();
-
-    size_t maxCol = 0;
-    for(size_t i = 0; i < colIndices.size(); ++i)
+    //count row offsets
+    size_t nOffsets = 0, lastOffset = 0, offset;
+    int status;
+    while ((status = stream.next(offset)) == 1)
     {
-        if(colIndices[i] > maxCol)
-            maxCol = colIndices[i];
+        ++nOffsets;
+        lastOffset = offset;
     }
-    const size_t nFeatures = maxCol;
-
-    if(!nFeatures || !nVectors || colIndices.size() != nNonZeros ||
-        nNonZeros != (rowOffsets[nVectors] - 1))
+    if (status < 0)
     {
         sparceFileReadError();
     }
+    if(!nOffsets)
+        return NULL;
+    const size_t nVectors = nOffsets - 1;
+    if(!nVectors || !lastOffset)
+    {
+        sparceFileReadError();
+    }
+    const size_t nNonZeros = lastOffset - 1;
 
+    //the number of features, the largest column index, is known once
+    //the indices are read: the table starts with one column
     size_t *resultRowOffsets = NULL;
     size_t *resultColIndices = NULL;
     item_type *resultData = NULL;
-    CSRNumericTable *numericTable = new CSRNumericTable(resultData, resultColIndices, resultRowOffsets, nFeatures, nVectors);
+    CSRNumericTable *numericTable = new CSRNumericTable(resultData, resultColIndices, resultRowOffsets, 1, nVectors);
     numericTable->allocateDataMemory(nNonZeros);
     numericTable->getArrays<item_type>(&resultData, &resultColIndices, &resultRowOffsets);
+
+    //read row offsets
+    stream.rewind();
+    for (size_t i = 0; i < nVectors + 1; ++i)
+    {
+        if (stream.next(resultRowOffsets[i]) != 1)
+        {
+            sparceFileReadError();
+        }
+    }
+    size_t extra;
+    if (stream.next(extra) != 0)
+    {
+        sparceFileReadError();
+    }
+
+    //read cols indices
+    size_t maxCol = 0;
     for (size_t i = 0; i < nNonZeros; ++i)
     {
-        resultData[i] = data[i];
-        resultColIndices[i] = colIndices[i];
+        if (stream.next(resultColIndices[i]) != 1)
+        {
+            sparceFileReadError();
+        }
+        if (resultColIndices[i] > maxCol)
+            maxCol = resultColIndices[i];
     }
-    for (size_t i = 0; i < nVectors + 1; ++i)
+    if (stream.next(extra) != 0)
     {
-        resultRowOffsets[i] = rowOffsets[i];
+        sparceFileReadError();
     }
+
+    //read values
+    for (size_t i = 0; i < nNonZeros; ++i)
+    {
+        if (stream.next(resultData[i]) != 1)
+        {
+            sparceFileReadError();
+        }
+    }
+    item_type extraValue;
+    if (stream.next(extraValue) != 0)
+    {
+        sparceFileReadError();
+    }
+
+    const size_t nFeatures = maxCol;
+    if(!nFeatures)
+    {
+        sparceFileReadError();
+    }
+
+    numericTable->setNumberOfColumns(nFeatures);
+    NumericTableFeature feature;
+    feature.setType<item_type>();
+    numericTable->getDictionary()->setAllFeatures(feature);
     return numericTable;
 }
 
@@ -670,68 +714,11 @@ size_t checkBytes(daal::byte *dst, daal::byte *src, size_t size)
     return 0;
 }
 
-static const unsigned int crcRem[] =
-{
-    0x00000000, 0x741B8CD6, 0xE83719AC, 0x9C2C957A, 0xA475BF8E, 0xD06E3358, 0x4C42A622, 0x38592AF4,
-    0x3CF0F3CA, 0x48EB7F1C, 0xD4C7EA66, 0xA0DC66B0, 0x98854C44, 0xEC9EC092, 0x70B255E8, 0x04A9D93E,
-    0x79E1E794, 0x0DFA6B42, 0x91D6FE38, 0xE5CD72EE, 0xDD94581A, 0xA98FD4CC, 0x35A341B6, 0x41B8CD60,
-    0x4511145E, 0x310A9888, 0xAD260DF2, 0xD93D8124, 0xE164ABD0, 0x957F2706, 0x0953B27C, 0x7D483EAA,
-    0xF3C3CF28, 0x87D843FE, 0x1BF4D684, 0x6FEF5A52, 0x57B670A6, 0x23ADFC70, 0xBF81690A, 0xCB9AE5DC,
-    0xCF333CE2, 0xBB28B034, 0x2704254E, 0x531FA998, 0x6B46836C, 0x1F5D0FBA, 0x83719AC0, 0xF76A1616,
-    0x8A2228BC, 0xFE39A46A, 0x62153110, 0x160EBDC6, 0x2E579732, 0x5A4C1BE4, 0xC6608E9E, 0xB27B0248,
-    0xB6D2DB76, 0xC2C957A0, 0x5EE5C2DA, 0x2AFE4E0C, 0x12A764F8, 0x66BCE82E, 0xFA907D54, 0x8E8BF182,
-    0x939C1286, 0xE7879E50, 0x7BAB0B2A, 0x0FB087FC, 0x37E9AD08, 0x43F221DE, 0xDFDEB4A4, 0xABC53872,
-    0xAF6CE14C, 0xDB776D9A, 0x475BF8E0, 0x33407436, 0x0B195EC2, 0x7F02D214, 0xE32E476E, 0x9735CBB8,
-    0xEA7DF512, 0x9E6679C4, 0x024AECBE, 0x76516068, 0x4E084A9C, 0x3A13C64A, 0xA63F5330, 0xD224DFE6,
-    0xD68D06D8, 0xA2968A0E, 0x3EBA1F74, 0x4AA193A2, 0x72F8B956, 0x06E33580, 0x9ACFA0FA, 0xEED42C2C,
-    0x605FDDAE, 0x14445178, 0x8868C402, 0xFC7348D4, 0xC42A6220, 0xB031EEF6, 0x2C1D7B8C, 0x5806F75A,
-    0x5CAF2E64, 0x28B4A2B2, 0xB49837C8, 0xC083BB1E, 0xF8DA91EA, 0x8CC11D3C, 0x10ED8846, 0x64F60490,
-    0x19BE3A3A, 0x6DA5B6EC, 0xF1892396, 0x8592AF40, 0xBDCB85B4, 0xC9D00962, 0x55FC9C18, 0x21E710CE,
-    0x254EC9F0, 0x51554526, 0xCD79D05C, 0xB9625C8A, 0x813B767E, 0xF520FAA8, 0x690C6FD2, 0x1D17E304,
-    0x5323A9DA, 0x2738250C, 0xBB14B076, 0xCF0F3CA0, 0xF7561654, 0x834D9A82, 0x1F610FF8, 0x6B7A832E,
-    0x6FD35A10, 0x1BC8D6C6, 0x87E443BC, 0xF3FFCF6A, 0xCBA6E59E, 0xBFBD6948, 0x2391FC32, 0x578A70E4,
-    0x2AC24E4E, 0x5ED9C298, 0xC2F557E2, 0xB6EEDB34, 0x8EB7F1C0, 0xFAAC7D16, 0x6680E86C, 0x129B64BA,
-    0x1632BD84, 0x62293152, 0xFE05A428, 0x8A1E28FE, 0xB247020A, 0xC65C8EDC, 0x5A701BA6, 0x2E6B9770,
-    0xA0E066F2, 0xD4FBEA24, 0x48D77F5E, 0x3CCCF388, 0x0495D97C, 0x708E55AA, 0xECA2C0D0, 0x98B94C06,
-    0x9C109538, 0xE80B19EE, 0x74278C94, 0x003C0042, 0x38652AB6, 0x4C7EA660, 0xD052331A, 0xA449BFCC,
-    0xD9018166, 0xAD1A0DB0, 0x313698CA, 0x452D141C, 0x7D743EE8, 0x096FB23E, 0x95432744, 0xE158AB92,
-    0xE5F172AC, 0x91EAFE7A, 0x0DC66B00, 0x79DDE7D6, 0x4184CD22, 0x359F41F4, 0xA9B3D48E, 0xDDA85858,
-    0xC0BFBB5C, 0xB4A4378A, 0x2888A2F0, 0x5C932E26, 0x64CA04D2, 0x10D18804, 0x8CFD1D7E, 0xF8E691A8,
-    0xFC4F4896, 0x8854C440, 0x1478513A, 0x6063DDEC, 0x583AF718, 0x2C217BCE, 0xB00DEEB4, 0xC4166262,
-    0xB95E5CC8, 0xCD45D01E, 0x51694564, 0x2572C9B2, 0x1D2BE346, 0x69306F90, 0xF51CFAEA, 0x8107763C,
-    0x85AEAF02, 0xF1B523D4, 0x6D99B6AE, 0x19823A78, 0x21DB108C, 0x55C09C5A, 0xC9EC0920, 0xBDF785F6,
-    0x337C7474, 0x4767F8A2, 0xDB4B6DD8, 0xAF50E10E, 0x9709CBFA, 0xE312472C, 0x7F3ED256, 0x0B255E80,
-    0x0F8C87BE, 0x7B970B68, 0xE7BB9E12, 0x93A012C4, 0xABF93830, 0xDFE2B4E6, 0x43CE219C, 0x37D5AD4A,
-    0x4A9D93E0, 0x3E861F36, 0xA2AA8A4C, 0xD6B1069A, 0xEEE82C6E, 0x9AF3A0B8, 0x06DF35C2, 0x72C4B914,
-    0x766D602A, 0x0276ECFC, 0x9E5A7986, 0xEA41F550, 0xD218DFA4, 0xA6035372, 0x3A2FC608, 0x4E344ADE
-};
-
+/* Slicing-by-16, or PCLMULQDQ folding where available (crc32.h): the
+ * same value as one byte at a time */
 unsigned int getCRC32( daal::byte *input, unsigned int prevRes, size_t len)
 {
-    size_t i;
-    daal::byte *p;
-
-    unsigned int res, highDigit, nextDigit;
-    const unsigned int crcPoly = 0xBA0DC66B;
-
-    p = input;
-
-    res = prevRes;
-
-    for ( i = 0; i < len; i++)
-    {
-        highDigit = res >> 24;
-        nextDigit = (unsigned int)(p[len - 1 - i]);
-        res       = (res << 8) ^ nextDigit;
-        res       = res ^ crcRem[highDigit];
-    }
-
-    if (res >= crcPoly)
-    {
-        res = res ^ crcPoly;
-    }
-
-    return res;
+    return crc32Finish(crc32Remainder(input, len, prevRes));
 }
 
 KeyValueDataCollectionPtr computeOutBlocks(size_t nBlocks,
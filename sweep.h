@@ -0,0 +1,347 @@
+/* file: sweep.h */
+/*
+!  Content:
+!    Parameter sweeps of the benchmark cases over sizes, threads, precisions
+!    and variants, timed with benchmark.h, with strong or weak scaling
+!    efficiency, written as a CSV or JSON table
+!******************************************************************************/
+
+#ifndef _SWEEP_H
+#define _SWEEP_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+
+/* One point of the grid. k is the third size of the algorithm: clusters
+ * for kmeans, boosting rounds for adaboost. */
+struct SweepPoint
+{
+    std::string variant;
+    std::string precision; /* "double" or "float" */
+    size_t n, d, k;
+    unsigned int threads;
+};
+
+struct SweepOptions
+{
+    std::vector<size_t> n, d, k;
+    std::vector<size_t> threads;
+    std::vector<std::string> precisions, variants;
+    bool weak;       /* n is per thread: each point runs n * threads rows */
+    std::string out; /* the table, "-" for CSV on stdout, *.json for JSON */
+
+    SweepOptions() : weak(false), out("-") {}
+};
+
+inline std::vector<std::string> splitList(const char *text)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/* "1000,5000", or ranges "first:last:xF" (times F) and "first:last:+S"
+ * (plus S), mixed freely: "1:8:x2,12" is 1,2,4,8,12 */
+inline std::vector<size_t> parseSizeList(const char *text)
+{
+    std::vector<size_t> sizes;
+    std::vector<std::string> items = splitList(text);
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        const char *p = items[i].c_str();
+        char *end;
+        size_t first = strtoull(p, &end, 10);
+        if (*end != ':')
+        {
+            sizes.push_back(first);
+            continue;
+        }
+        size_t last = strtoull(end + 1, &end, 10);
+        size_t step = 2;
+        bool times  = true;
+        if (*end == ':' && (end[1] == 'x' || end[1] == '+'))
+        {
+            times = end[1] == 'x';
+            step  = strtoull(end + 2, NULL, 10);
+        }
+        if (step < (times ? 2u : 1u) || first == 0)
+        {
+            sizes.push_back(first);
+            continue;
+        }
+        for (size_t v = first; v <= last; v = times ? v * step : v + step)
+        {
+            sizes.push_back(v);
+        }
+    }
+    return sizes;
+}
+
+/* 1, 2, 4, ... up to the hardware threads, and those */
+inline std::vector<size_t> defaultSweepThreads()
+{
+    std::vector<size_t> threads;
+    const size_t all = getNumberOfThreads();
+    for (size_t t = 1; t < all; t *= 2)
+    {
+        threads.push_back(t);
+    }
+    threads.push_back(all);
+    return threads;
+}
+
+/* Removes the sweep options from argv, the others are left for the
+ * driver and benchmark.h:
+ *   --n LIST          rows or points (per thread with --weak)
+ *   --d LIST          values per row
+ *   --k LIST          clusters (kmeans) or rounds (adaboost)
+ *   --threads LIST    default 1, 2, 4, ... all cores
+ *   --precision LIST  double,float
+ *   --variant LIST    the driver's variants, default all
+ *   --weak            weak scaling: n grows with the threads
+ *   --out FILE        the table, CSV unless FILE ends in .json; default
+ *                     CSV on stdout
+ * The fields of options already set are the defaults. */
+inline void parseSweepOptions(int &argc, char *argv[], SweepOptions &options)
+{
+    int kept = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (hasValue && strcmp(argv[i], "--n") == 0)
+        {
+            options.n = parseSizeList(argv[++i]);
+        }
+        else if (hasValue && strcmp(argv[i], "--d") == 0)
+        {
+            options.d = parseSizeList(argv[++i]);
+        }
+        else if (hasValue && strcmp(argv[i], "--k") == 0)
+        {
+            options.k = parseSizeList(argv[++i]);
+        }
+        else if (hasValue && strcmp(argv[i], "--threads") == 0)
+        {
+            options.threads = parseSizeList(argv[++i]);
+        }
+        else if (hasValue && strcmp(argv[i], "--precision") == 0)
+        {
+            options.precisions = splitList(argv[++i]);
+        }
+        else if (hasValue && strcmp(argv[i], "--variant") == 0)
+        {
+            options.variants = splitList(argv[++i]);
+        }
+        else if (hasValue && strcmp(argv[i], "--out") == 0)
+        {
+            options.out = argv[++i];
+        }
+        else if (strcmp(argv[i], "--weak") == 0)
+        {
+            options.weak = true;
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc       = kept;
+    argv[argc] = NULL;
+
+    if (options.threads.empty())
+    {
+        options.threads = defaultSweepThreads();
+    }
+}
+
+struct SweepRow
+{
+    std::string algorithm;
+    SweepPoint point;
+    BenchmarkResult result;
+    double speedup;    /* over the fewest threads of the same problem */
+    double efficiency; /* speedup per added thread, 1 is perfect */
+};
+
+/* Strong scaling compares the same n, weak scaling the same n per thread;
+ * the baseline is the row with the fewest threads. */
+inline void computeScaling(std::vector<SweepRow> &rows, bool weak)
+{
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const SweepPoint &p = rows[i].point;
+        const SweepRow *base = NULL;
+        for (size_t j = 0; j < rows.size(); j++)
+        {
+            const SweepPoint &q = rows[j].point;
+            bool same = rows[j].algorithm == rows[i].algorithm && q.variant == p.variant && q.precision == p.precision && q.d == p.d
+                        && q.k == p.k && (weak ? q.n / q.threads == p.n / p.threads : q.n == p.n);
+            if (same && (!base || q.threads < base->point.threads))
+            {
+                base = &rows[j];
+            }
+        }
+
+        const double ratio = (double)p.threads / base->point.threads;
+        const double time  = rows[i].result.seconds.median;
+        const double gain  = time > 0 ? base->result.seconds.median / time : 0;
+        rows[i].speedup    = weak ? gain * ratio : gain;
+        rows[i].efficiency = weak ? gain : gain / ratio;
+    }
+}
+
+inline void writeSweepCsv(FILE *f, const std::vector<SweepRow> &rows, bool weak)
+{
+    fprintf(f, "algorithm,variant,precision,N,D,K,threads,scaling,samples,median_seconds,p95_seconds,stddev_seconds,median_cycles,"
+               "items_per_second,gflops,gbytes_per_second,ipc,speedup,efficiency\n");
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const SweepRow &row      = rows[i];
+        const SweepPoint &p      = row.point;
+        const BenchmarkResult &r = row.result;
+        const double t           = r.seconds.median > 0 ? r.seconds.median : 0;
+        fprintf(f, "%s,%s,%s,%zu,%zu,%zu,%u,%s,%zu,%.9g,%.9g,%.9g,%.9g,", row.algorithm.c_str(), p.variant.c_str(), p.precision.c_str(), p.n, p.d, p.k,
+                p.threads, weak ? "weak" : "strong", r.samples, r.seconds.median, r.seconds.p95, r.seconds.stddev, r.cycles.median);
+        fprintf(f, t > 0 ? "%.9g," : ",", r.itemsPerRun / t);
+        fprintf(f, t > 0 && r.flopsPerRun > 0 ? "%.9g," : ",", r.flopsPerRun / t * 1e-9);
+        fprintf(f, t > 0 && r.bytesPerRun > 0 ? "%.9g," : ",", r.bytesPerRun / t * 1e-9);
+        fprintf(f, r.ipc() >= 0 ? "%.6g," : ",", r.ipc());
+        fprintf(f, "%.6g,%.6g\n", row.speedup, row.efficiency);
+    }
+}
+
+inline void writeSweepJson(FILE *f, const char *program, const std::vector<SweepRow> &rows, bool weak)
+{
+    fprintf(f, "{\n  \"context\": {");
+    writeJsonContext(f, program);
+    fprintf(f, ", \"scaling\": \"%s\"},\n  \"rows\": [", weak ? "weak" : "strong");
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const SweepRow &row      = rows[i];
+        const SweepPoint &p      = row.point;
+        const BenchmarkResult &r = row.result;
+        fprintf(f, "%s\n    {\"algorithm\": %s, \"variant\": %s, \"precision\": %s, \"N\": %zu, \"D\": %zu, \"K\": %zu, \"threads\": %u, ", i ? "," : "",
+                jsonString(row.algorithm).c_str(), jsonString(p.variant).c_str(), jsonString(p.precision).c_str(), p.n, p.d, p.k, p.threads);
+        fprintf(f, "\"samples\": %zu, ", r.samples);
+        writeJsonStats(f, "seconds", r.seconds);
+        fprintf(f, ", ");
+        writeJsonStats(f, "cycles", r.cycles);
+        if (r.seconds.median > 0)
+        {
+            fprintf(f, ", \"items_per_second\": %.9g", r.itemsPerRun / r.seconds.median);
+            if (r.flopsPerRun > 0)
+            {
+                fprintf(f, ", \"gflops\": %.9g", r.flopsPerRun / r.seconds.median * 1e-9);
+            }
+            if (r.bytesPerRun > 0)
+            {
+                fprintf(f, ", \"gbytes_per_second\": %.9g", r.bytesPerRun / r.seconds.median * 1e-9);
+            }
+        }
+        if (r.ipc() >= 0)
+        {
+            fprintf(f, ", \"ipc\": %.6g", r.ipc());
+        }
+        fprintf(f, ", \"speedup\": %.6g, \"efficiency\": %.6g}", row.speedup, row.efficiency);
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+/* Runs the grid. measure(point, c) sets up the data of the point and fills
+ * c.run (and the item, flop and byte counts) or returns false when the
+ * variant cannot run the point, e.g. a single-threaded variant with
+ * several threads or a precision it does not have. Points are visited
+ * with the threads innermost, so that the data can be kept between them. */
+template <typename Measure>
+std::vector<SweepRow> runSweep(const char *algorithm, const SweepOptions &sweep, BenchmarkOptions options, Measure measure)
+{
+    const bool toStdout = sweep.out == "-";
+    if (toStdout)
+    {
+        options.text = false;
+    }
+
+    std::vector<SweepRow> rows;
+    for (size_t v = 0; v < sweep.variants.size(); v++)
+        for (size_t p = 0; p < sweep.precisions.size(); p++)
+            for (size_t d = 0; d < sweep.d.size(); d++)
+                for (size_t k = 0; k < sweep.k.size(); k++)
+                    for (size_t n = 0; n < sweep.n.size(); n++)
+                        for (size_t t = 0; t < sweep.threads.size(); t++)
+                        {
+                            SweepPoint point;
+                            point.variant   = sweep.variants[v];
+                            point.precision = sweep.precisions[p];
+                            point.d         = sweep.d[d];
+                            point.k         = sweep.k[k];
+                            point.threads   = sweep.threads[t];
+                            point.n         = sweep.weak ? sweep.n[n] * point.threads : sweep.n[n];
+
+                            std::ostringstream name;
+                            name << algorithm << "/" << point.variant << "/" << point.precision << "/N=" << point.n << "/D=" << point.d << "/K=" << point.k
+                                 << "/threads=" << point.threads;
+
+                            BenchmarkCase c;
+                            c.name        = name.str();
+                            c.itemsPerRun = (double)point.n;
+                            c.flopsPerRun = 0;
+                            c.bytesPerRun = 0;
+                            if (!options.filter.empty() && c.name.find(options.filter) == std::string::npos)
+                            {
+                                continue;
+                            }
+                            if (!measure(point, c))
+                            {
+                                continue;
+                            }
+
+                            SweepRow row;
+                            row.algorithm = algorithm;
+                            row.point     = point;
+                            row.result    = runBenchmark(c, options);
+                            if (options.text)
+                            {
+                                printBenchmarkResult(row.result);
+                            }
+                            rows.push_back(row);
+                        }
+
+    computeScaling(rows, sweep.weak);
+
+    const bool json = sweep.out.size() > 5 && sweep.out.compare(sweep.out.size() - 5, 5, ".json") == 0;
+    FILE *f         = toStdout ? stdout : fopen(sweep.out.c_str(), "w");
+    if (!f)
+    {
+        fprintf(stderr, "Unable to write file '%s'\n", sweep.out.c_str());
+        return rows;
+    }
+    if (json)
+    {
+        writeSweepJson(f, algorithm, rows, sweep.weak);
+    }
+    else
+    {
+        writeSweepCsv(f, rows, sweep.weak);
+    }
+    if (!toStdout)
+    {
+        fclose(f);
+    }
+    return rows;
+}
+
+#endif